@@ -214,7 +214,7 @@ mb_wm_client_app_theme_change (MBWindowManagerClient *client)
       MBWMList * n = l->next;
 
       mb_wm_object_unref (MB_WM_OBJECT (d));
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
@@ -152,7 +152,7 @@ mb_wm_client_desktop_theme_change (MBWindowManagerClient *client)
       MBWMList * n = l->next;
 
       mb_wm_object_unref (MB_WM_OBJECT (d));
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
@@ -64,8 +64,11 @@ mb_wm_client_panel_init (MBWMObject *this, va_list vap)
       if (x < 0 || y < 0 || w < 0 || h < 0)
 	{
 	  Window root;
+	  gint64 start = g_get_monotonic_time ();
+
 	  XGetGeometry (wm->xdpy, win->xwindow,
 			&root, &g_x, &g_y, &g_w, &g_h, &g_bw, &g_d);
+	  mb_wm_stats_round_trip (start);
 	}
 
       if (x < 0)
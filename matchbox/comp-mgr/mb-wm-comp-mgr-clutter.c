@@ -42,6 +42,17 @@
 #define SHADOW_OFFSET_X	(-SHADOW_RADIUS)
 #define SHADOW_OFFSET_Y	(-SHADOW_RADIUS)
 
+/* A fullscreen client must stay on top this long before it is unredirected,
+ * and after we go back to compositing we stay there at least for
+ * UNREDIRECT_HOLD_MS, so clients toggling quickly do not make us flap. */
+#define UNREDIRECT_DELAY_MS  500
+#define UNREDIRECT_HOLD_MS  1000
+
+/* Update rates (frames per second) are turned into delays in ms; this is
+ * what "no limit" and "no updates at all" come out as. */
+#define UPDATE_DELAY_NONE     0
+#define UPDATE_DELAY_FROZEN  -1
+
 #define MAX_TILE_SZ 16 	/* make sure size/2 < MAX_TILE_SZ */
 #define WIDTH  (3*MAX_TILE_SZ)
 #define HEIGHT (3*MAX_TILE_SZ)
@@ -51,6 +62,8 @@ mb_wm_comp_mgr_clutter_add_actor (MBWMCompMgrClutter *,
 				  MBWMCompMgrClutterClient *);
 static void
 mb_wm_comp_mgr_clutter_fetch_texture (MBWMCompMgrClient *client);
+static void
+mb_wm_comp_mgr_clutter_forget_client (MBWMCompMgrClient *client);
 
 /**
  * Implementation of MBWMCompMgrClutterClient.
@@ -69,6 +82,18 @@ struct MBWMCompMgrClutterClientPrivate
   /* have we been unmapped - if so we need to re-create our texture when
    * we are re-mapped */
   Bool                    unmapped;
+
+  /* hidden and not tracking damage because nothing of us can be seen */
+  Bool                    culled;
+
+  /* pixmap released to stay within the texture budget */
+  Bool                    evicted;
+  gint64                  last_visible;
+
+  /* damage rate limiting */
+  guint                   max_fps;        /* 0 to follow the rules */
+  gint64                  last_update;
+  unsigned long           update_timeout_id;
 };
 
 static void
@@ -232,7 +257,6 @@ mb_wm_comp_mgr_clutter_fetch_texture (MBWMCompMgrClient *client)
 #if defined(HAVE_XEXT)
   /* Stuff we need for shaped windows */
   XRectangle                *shp_rect;
-  int                        shp_order;
   int                        shp_count;
   int                        i;
 #endif
@@ -264,6 +288,7 @@ mb_wm_comp_mgr_clutter_fetch_texture (MBWMCompMgrClient *client)
     }
 
   cclient->priv->bound = TRUE;
+  cclient->priv->evicted = FALSE;
 
 #if defined(HAVE_XEXT)
   /*
@@ -276,8 +301,8 @@ mb_wm_comp_mgr_clutter_fetch_texture (MBWMCompMgrClient *client)
 
   if (mb_wm_theme_is_client_shaped (wm->theme, wm_client))
     {
-      shp_rect = XShapeGetRectangles (wm->xdpy, xwin,
-				     ShapeBounding, &shp_count, &shp_order);
+      shp_rect = mb_wm_client_window_get_shape (wm_client->window,
+						&shp_count);
 
       if (shp_rect && shp_count)
 	{
@@ -293,8 +318,6 @@ mb_wm_comp_mgr_clutter_fetch_texture (MBWMCompMgrClient *client)
 	          CLUTTER_X11_TEXTURE_PIXMAP (cclient->priv->texture),
 	          geo);
 	    }
-
-	  XFree (shp_rect);
 	}
     }
 
@@ -336,6 +359,39 @@ mb_wm_comp_mgr_clutter_client_actor_reparent_cb(ClutterActor *actor)
   recursive_set_texture_filter(actor, &filter);
 }
 
+/*
+ * Gives an evicted client its pixmap back, refetching the whole texture
+ * since all the damage was dropped while it was away.
+ */
+static void
+mb_wm_comp_mgr_clutter_client_restore_texture (MBWMCompMgrClutterClient *cclient)
+{
+  guint w, h;
+
+  MBWM_NOTE (COMPOSITOR, "restoring texture of %lx",
+	     MB_WM_COMP_MGR_CLIENT (cclient)->wm_client->window->xwindow);
+
+  mb_wm_comp_mgr_clutter_fetch_texture (MB_WM_COMP_MGR_CLIENT (cclient));
+
+  if (cclient->priv->bound && !cclient->priv->evicted)
+    {
+      clutter_actor_get_size (cclient->priv->texture, &w, &h);
+      clutter_x11_texture_pixmap_update_area (
+			CLUTTER_X11_TEXTURE_PIXMAP (cclient->priv->texture),
+			0, 0, w, h);
+    }
+}
+
+/* Shown by someone (the shell, most likely): make sure there is something
+ * to show */
+static void
+mb_wm_comp_mgr_clutter_client_actor_show_cb (ClutterActor             *actor,
+					     MBWMCompMgrClutterClient *cclient)
+{
+  if (cclient->priv && cclient->priv->evicted)
+    mb_wm_comp_mgr_clutter_client_restore_texture (cclient);
+}
+
 static int
 mb_wm_comp_mgr_clutter_client_init (MBWMObject *obj, va_list vap)
 {
@@ -356,6 +412,10 @@ mb_wm_comp_mgr_clutter_client_init (MBWMObject *obj, va_list vap)
       cclient->priv->actor, "parent-set",
       G_CALLBACK(mb_wm_comp_mgr_clutter_client_actor_reparent_cb),
       cclient);
+  g_signal_connect(
+      cclient->priv->actor, "show",
+      G_CALLBACK(mb_wm_comp_mgr_clutter_client_actor_show_cb),
+      cclient);
 
 #if DEBUG_ACTOR
   g_signal_connect(cclient->priv->actor, "destroy", G_CALLBACK(destroy_cb), cclient);
@@ -369,6 +429,8 @@ mb_wm_comp_mgr_clutter_client_destroy (MBWMObject* obj)
 {
   MBWMCompMgrClutterClient *cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (obj);
 
+  mb_wm_comp_mgr_clutter_forget_client (MB_WM_COMP_MGR_CLIENT (obj));
+
   /* We just unref our actors here and clutter will free them if required */
   if (cclient->priv->actor)
     {
@@ -532,6 +594,20 @@ struct MBWMCompMgrClutterPrivate
   MBWMList     * desktops;
 
   Window         overlay_window;
+
+  Bool           culling;
+
+  gsize                   texture_budget; /* bytes, 0 for no limit */
+
+  guint                   update_rate[MBWMCompMgrClutterRateRuleCount];
+
+  Bool                    auto_unredirect;
+  MBWindowManagerClient * unredirect_candidate;
+  unsigned long           unredirect_timeout_id;
+  MBWindowManagerClient * unredirected;
+  gint64                  composited_since;
+
+  gulong                  stage_paint_id;
 };
 
 static void
@@ -539,6 +615,10 @@ mb_wm_comp_mgr_clutter_private_free (MBWMCompMgrClutter *mgr)
 {
   MBWMCompMgrClutterPrivate * priv = mgr->priv;
 
+  if (priv->stage_paint_id)
+    g_signal_handler_disconnect (clutter_stage_get_default (),
+				 priv->stage_paint_id);
+
   free (priv);
 }
 
@@ -579,6 +659,9 @@ mb_wm_comp_mgr_clutter_map_notify_real (MBWMCompMgr *mgr,
 static void
 mb_wm_comp_mgr_clutter_restack_real (MBWMCompMgr *mgr);
 
+static void
+mb_wm_comp_mgr_clutter_render_real (MBWMCompMgr *mgr);
+
 static Bool
 mb_wm_comp_mgr_is_my_window_real (MBWMCompMgr * mgr, Window xwin);
 
@@ -602,8 +685,8 @@ mb_wm_comp_mgr_clutter_class_init (MBWMObjectClass *klass)
 #endif
 
   /*
-   * NB -- we do not need render() implementation, since that is taken care of
-   * automatically by clutter stage.
+   * NB -- the painting itself is taken care of automatically by clutter
+   * stage; render() only decides which clients are worth painting.
    */
   cm_klass->register_client   = mb_wm_comp_mgr_clutter_register_client_real;
   cm_klass->turn_on           = mb_wm_comp_mgr_clutter_turn_on_real;
@@ -612,6 +695,7 @@ mb_wm_comp_mgr_clutter_class_init (MBWMObjectClass *klass)
   cm_klass->map_notify        = mb_wm_comp_mgr_clutter_map_notify_real;
   cm_klass->my_window         = mb_wm_comp_mgr_is_my_window_real;
   cm_klass->restack           = mb_wm_comp_mgr_clutter_restack_real;
+  cm_klass->render            = mb_wm_comp_mgr_clutter_render_real;
   cm_klass->select_desktop    = mb_wm_comp_mgr_clutter_select_desktop;
   cm_klass->handle_damage     = mb_wm_comp_mgr_clutter_handle_damage;
   cm_klass->screen_size_changed = mb_wm_comp_mgr_clutter_screen_size_changed;
@@ -619,6 +703,33 @@ mb_wm_comp_mgr_clutter_class_init (MBWMObjectClass *klass)
   clutter_klass->client_new   = mb_wm_comp_mgr_clutter_client_new;
 }
 
+/*
+ * Ends the latency probes of the clients in the frame just painted; the
+ * buffer swap that puts it on screen is still to come.
+ */
+static void
+mb_wm_comp_mgr_clutter_stage_paint_cb (ClutterActor *stage, MBWMCompMgr *mgr)
+{
+  MBWindowManagerClient * c;
+
+  if (!mb_wm_stats_probes_waiting ())
+    return;
+
+  mb_wm_stack_enumerate (mgr->wm, c)
+    {
+      MBWMCompMgrClutterClient * cc;
+
+      if (!c->cm_client)
+	continue;
+
+      cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+
+      if (cc->priv->actor && CLUTTER_ACTOR_IS_VISIBLE (cc->priv->actor) &&
+	  (cc->priv->flags & MBWMCompMgrClutterClientMapped))
+	mb_wm_stats_probe_shown (c);
+    }
+}
+
 static int
 mb_wm_comp_mgr_clutter_init (MBWMObject *obj, va_list vap)
 {
@@ -631,6 +742,16 @@ mb_wm_comp_mgr_clutter_init (MBWMObject *obj, va_list vap)
   priv = mb_wm_util_malloc0 (sizeof (MBWMCompMgrClutterPrivate));
   cmgr->priv = priv;
 
+  if (getenv ("MB_TEXTURE_BUDGET_KB"))
+    priv->texture_budget =
+      (gsize) strtoul (getenv ("MB_TEXTURE_BUDGET_KB"), NULL, 10) * 1024;
+
+  if (getenv ("MB_AUTO_UNREDIRECT"))
+    priv->auto_unredirect = True;
+
+  if (getenv ("MB_OCCLUSION_CULLING"))
+    priv->culling = True;
+
   XCompositeRedirectSubwindows (wm->xdpy, wm->root_win->xwindow,
 				CompositeRedirectManual);
 
@@ -646,6 +767,11 @@ mb_wm_comp_mgr_clutter_init (MBWMObject *obj, va_list vap)
   clutter_container_add_actor (CLUTTER_CONTAINER (arena), desktop);
   priv->desktops = mb_wm_util_list_append (priv->desktops, desktop);
 
+  priv->stage_paint_id =
+    g_signal_connect_after (clutter_stage_get_default (), "paint",
+			    G_CALLBACK (mb_wm_comp_mgr_clutter_stage_paint_cb),
+			    mgr);
+
   return 1;
 }
 
@@ -657,6 +783,11 @@ mb_wm_comp_mgr_clutter_destroy (MBWMObject * obj)
 
   mb_wm_comp_mgr_turn_off (mgr);
   mb_wm_comp_mgr_clutter_private_free (cmgr);
+  cmgr->priv = NULL;
+
+  /* Clients outliving us must not find us through the wm */
+  if (mgr->wm && mgr->wm->comp_mgr == mgr)
+    mgr->wm->comp_mgr = NULL;
 }
 
 int
@@ -680,6 +811,274 @@ mb_wm_comp_mgr_clutter_class_type ()
   return type;
 }
 
+/*
+ * Automatic unredirection: when an opaque fullscreen client is the topmost
+ * visible one, there is nothing to composite, so we let it draw straight to
+ * the screen and hide the stage until something else needs to be seen.
+ */
+static MBWindowManagerClient *
+mb_wm_comp_mgr_clutter_unredirect_candidate (MBWMCompMgrClutter *cmgr)
+{
+  MBWindowManager       * wm = MB_WM_COMP_MGR (cmgr)->wm;
+  MBWindowManagerClient * c;
+
+  /* The shell is doing it all by itself */
+  if (!cmgr->priv->auto_unredirect || wm->non_redirection)
+    return NULL;
+
+  for (c = wm->stack_top; c; c = c->stacked_below)
+    {
+      MBWMCompMgrClutterClient * cc;
+
+      if (!mb_wm_client_is_visible (c))
+	continue;
+
+      /* This is the topmost visible client; it is either it, or nobody */
+      if (!c->cm_client ||
+	  !mb_wm_client_window_is_state_set (c->window,
+					     MBWMClientWindowEWMHStateFullscreen) ||
+	  !mb_wm_client_is_opaque (c) ||
+	  !mb_wm_client_covers_screen (c))
+	return NULL;
+
+      cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+
+      if (!cc->priv->actor ||
+	  !(cc->priv->flags & MBWMCompMgrClutterClientMapped) ||
+	  (cc->priv->flags & MBWMCompMgrClutterClientEffectRunning) ||
+	  (cc->priv->unredirected && c != cmgr->priv->unredirected))
+	return NULL;
+
+      return c;
+    }
+
+  return NULL;
+}
+
+static void
+mb_wm_comp_mgr_clutter_set_stage_visible (MBWMCompMgrClutter *cmgr,
+					  Bool                visible)
+{
+  MBWindowManager * wm = MB_WM_COMP_MGR (cmgr)->wm;
+  ClutterActor    * stage = clutter_stage_get_default ();
+
+  if (cmgr->priv->overlay_window != None)
+    {
+      XserverRegion region = None;
+
+      mb_wm_util_async_trap_x_errors_warn (wm->xdpy, "overlay shape");
+
+      /* An empty bounding shape lets the unredirected client through */
+      if (!visible)
+	region = XFixesCreateRegion (wm->xdpy, NULL, 0);
+
+      XFixesSetWindowShapeRegion (wm->xdpy, cmgr->priv->overlay_window,
+				  ShapeBounding, 0, 0, region);
+
+      if (region)
+	XFixesDestroyRegion (wm->xdpy, region);
+
+      mb_wm_util_async_untrap_x_errors ();
+    }
+
+  if (visible)
+    clutter_actor_show (stage);
+  else
+    clutter_actor_hide (stage);
+}
+
+static void
+mb_wm_comp_mgr_clutter_unredirect (MBWMCompMgrClutter    *cmgr,
+				   MBWindowManagerClient *c)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR (cmgr)->wm;
+
+  MBWM_NOTE (COMPOSITOR, "unredirecting fullscreen %lx", c->window->xwindow);
+
+  mb_wm_comp_mgr_clutter_set_client_redirection (c->cm_client, FALSE);
+
+  if (c->xwin_frame)
+    {
+      mb_wm_util_async_trap_x_errors (wm->xdpy);
+      XCompositeUnredirectWindow (wm->xdpy, c->xwin_frame,
+				  CompositeRedirectManual);
+      mb_wm_util_async_untrap_x_errors ();
+    }
+
+  mb_wm_comp_mgr_clutter_set_stage_visible (cmgr, False);
+
+  cmgr->priv->unredirected = c;
+}
+
+static void
+mb_wm_comp_mgr_clutter_redirect_back (MBWMCompMgrClutter *cmgr)
+{
+  MBWindowManager       *wm = MB_WM_COMP_MGR (cmgr)->wm;
+  MBWindowManagerClient *c = cmgr->priv->unredirected;
+
+  MBWM_NOTE (COMPOSITOR, "compositing %lx again", c->window->xwindow);
+
+  cmgr->priv->unredirected = NULL;
+  cmgr->priv->composited_since = g_get_monotonic_time ();
+
+  if (c->xwin_frame)
+    {
+      mb_wm_util_async_trap_x_errors (wm->xdpy);
+      XCompositeRedirectWindow (wm->xdpy, c->xwin_frame,
+				CompositeRedirectManual);
+      mb_wm_util_async_untrap_x_errors ();
+    }
+
+  /* This refetches the texture as well */
+  mb_wm_comp_mgr_clutter_set_client_redirection (c->cm_client, TRUE);
+
+  mb_wm_comp_mgr_clutter_set_stage_visible (cmgr, True);
+}
+
+static Bool
+mb_wm_comp_mgr_clutter_unredirect_timeout (void *userdata)
+{
+  MBWMCompMgrClutter    *cmgr = userdata;
+  MBWindowManagerClient *c;
+
+  cmgr->priv->unredirect_timeout_id = 0;
+
+  c = mb_wm_comp_mgr_clutter_unredirect_candidate (cmgr);
+
+  if (c && c == cmgr->priv->unredirect_candidate)
+    {
+      mb_wm_comp_mgr_clutter_unredirect (cmgr, c);
+      XFlush (MB_WM_COMP_MGR (cmgr)->wm->xdpy);
+    }
+
+  cmgr->priv->unredirect_candidate = NULL;
+
+  return False;
+}
+
+/* Called from render(), i.e., after every sync */
+static void
+mb_wm_comp_mgr_clutter_update_unredirection (MBWMCompMgrClutter *cmgr)
+{
+  MBWMCompMgrClutterPrivate *priv = cmgr->priv;
+  MBWindowManager           *wm = MB_WM_COMP_MGR (cmgr)->wm;
+  MBWindowManagerClient     *c;
+
+  c = mb_wm_comp_mgr_clutter_unredirect_candidate (cmgr);
+
+  if (priv->unredirected)
+    {
+      if (c == priv->unredirected)
+	return;
+
+      /* Something has to be composited again; no point in waiting */
+      mb_wm_comp_mgr_clutter_redirect_back (cmgr);
+    }
+
+  if (c == priv->unredirect_candidate)
+    return;
+
+  if (priv->unredirect_timeout_id)
+    {
+      mb_wm_main_context_timeout_handler_remove (wm->main_ctx,
+						 priv->unredirect_timeout_id);
+      priv->unredirect_timeout_id = 0;
+    }
+
+  priv->unredirect_candidate = c;
+
+  if (c)
+    {
+      gint64 held = (g_get_monotonic_time () - priv->composited_since) / 1000;
+      int    delay = UNREDIRECT_DELAY_MS;
+
+      if (held < UNREDIRECT_HOLD_MS && UNREDIRECT_HOLD_MS - held > delay)
+	delay = UNREDIRECT_HOLD_MS - held;
+
+      priv->unredirect_timeout_id =
+	mb_wm_main_context_timeout_handler_add (wm->main_ctx, delay,
+				mb_wm_comp_mgr_clutter_unredirect_timeout,
+				cmgr);
+    }
+}
+
+/* Drops the damage update held back by the rate limit, if any */
+static void
+mb_wm_comp_mgr_clutter_client_cancel_update (MBWMCompMgrClutterClient *cclient)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR_CLIENT (cclient)->wm;
+
+  if (cclient->priv->update_timeout_id)
+    {
+      mb_wm_main_context_timeout_handler_remove (wm->main_ctx,
+					cclient->priv->update_timeout_id);
+      cclient->priv->update_timeout_id = 0;
+    }
+}
+
+/* Drops any reference the unredirection and update rate policies hold to a
+ * dying client */
+static void
+mb_wm_comp_mgr_clutter_forget_client (MBWMCompMgrClient *client)
+{
+  MBWindowManager           *wm = client->wm;
+  MBWMCompMgrClutterPrivate *priv;
+
+  if (!wm)
+    return;
+
+  mb_wm_comp_mgr_clutter_client_cancel_update
+				(MB_WM_COMP_MGR_CLUTTER_CLIENT (client));
+
+  if (!client->wm_client)
+    return;
+
+  /*
+   * Turning the manager off has already dropped what the policies held, and
+   * the manager may be gone by the time the last client is freed.
+   */
+  if (!mb_wm_comp_mgr_enabled (wm->comp_mgr) ||
+      !MB_WM_COMP_MGR_CLUTTER (wm->comp_mgr)->priv)
+    return;
+
+  priv = MB_WM_COMP_MGR_CLUTTER (wm->comp_mgr)->priv;
+
+  if (priv->unredirect_candidate == client->wm_client)
+    {
+      if (priv->unredirect_timeout_id)
+	mb_wm_main_context_timeout_handler_remove (wm->main_ctx,
+						   priv->unredirect_timeout_id);
+      priv->unredirect_timeout_id = 0;
+      priv->unredirect_candidate = NULL;
+    }
+
+  if (priv->unredirected == client->wm_client)
+    {
+      /* The window is going away, so just bring the stage back */
+      priv->unredirected = NULL;
+      priv->composited_since = g_get_monotonic_time ();
+      mb_wm_comp_mgr_clutter_set_stage_visible
+	(MB_WM_COMP_MGR_CLUTTER (wm->comp_mgr), True);
+    }
+}
+
+/*
+ * Automatic unredirection of fullscreen clients is off by default, as a
+ * shell may paint things of its own over them; it can be turned on here or
+ * by setting MB_AUTO_UNREDIRECT in the environment.
+ */
+void
+mb_wm_comp_mgr_clutter_set_auto_unredirect (MBWMCompMgrClutter *cmgr,
+					    Bool                enabled)
+{
+  MBWMCompMgr *mgr = MB_WM_COMP_MGR (cmgr);
+
+  cmgr->priv->auto_unredirect = enabled;
+
+  if (!mgr->disabled)
+    mb_wm_comp_mgr_clutter_update_unredirection (cmgr);
+}
+
 /* Shuts the compositing down */
 static void
 mb_wm_comp_mgr_clutter_turn_off_real (MBWMCompMgr *mgr)
@@ -696,12 +1095,29 @@ mb_wm_comp_mgr_clutter_turn_off_real (MBWMCompMgr *mgr)
   if (mgr->disabled)
     return;
 
+  if (priv->unredirect_timeout_id)
+    {
+      mb_wm_main_context_timeout_handler_remove (wm->main_ctx,
+						 priv->unredirect_timeout_id);
+      priv->unredirect_timeout_id = 0;
+    }
+
+  priv->unredirect_candidate = NULL;
+
+  if (priv->unredirected)
+    mb_wm_comp_mgr_clutter_redirect_back (MB_WM_COMP_MGR_CLUTTER (mgr));
+
   if (!mb_wm_stack_empty (wm))
     {
       MBWindowManagerClient * c;
 
       mb_wm_stack_enumerate (wm, c)
 	{
+	  /* The client may outlive its connection to the wm client */
+	  if (c->cm_client)
+	    mb_wm_comp_mgr_clutter_client_cancel_update
+				(MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client));
+
 	  mb_wm_comp_mgr_unregister_client (mgr, c);
 	}
     }
@@ -820,6 +1236,13 @@ mb_wm_comp_mgr_clutter_client_repair_real (MBWMCompMgrClient *client,
   if (!cclient->priv->actor || cclient->priv->damage_handling_off)
     return;
 
+  if (cclient->priv->evicted)
+    {
+      /* Nothing to update; the whole texture is refetched when shown */
+      XDamageSubtract (wm->xdpy, damage, None, None);
+      return;
+    }
+
   if (!cclient->priv->bound)
     {
       /*
@@ -884,6 +1307,111 @@ mb_wm_comp_mgr_clutter_client_configure_real (MBWMCompMgrClient * client)
   mb_wm_comp_mgr_clutter_client_set_size(cclient, FALSE);
 }
 
+static Bool
+mb_wm_comp_mgr_clutter_client_is_scaled (MBWMCompMgrClutterClient *cclient)
+{
+  ClutterActor *a;
+
+  for (a = cclient->priv->actor; a; a = clutter_actor_get_parent (a))
+    {
+      gdouble sx, sy;
+
+      clutter_actor_get_scale (a, &sx, &sy);
+
+      if (sx < 1.0 || sy < 1.0)
+	return True;
+    }
+
+  return False;
+}
+
+static Bool
+mb_wm_comp_mgr_clutter_client_is_partially_occluded (MBWindowManagerClient *c)
+{
+  Region     visible = mb_wm_client_get_visible_region (c);
+  MBGeometry geom;
+
+  if (!visible)
+    return False;
+
+  mb_wm_client_get_coverage (c, &geom);
+
+  return XRectInRegion (visible, geom.x, geom.y,
+			geom.width, geom.height) != RectangleIn;
+}
+
+/*
+ * How long (in ms) the client has to wait between texture updates: the
+ * lowest of the rates set on it and by the rules it falls under wins.
+ */
+static int
+mb_wm_comp_mgr_clutter_client_update_delay (MBWMCompMgrClutter       *cmgr,
+					    MBWMCompMgrClutterClient *cclient)
+{
+  MBWindowManagerClient *c = MB_WM_COMP_MGR_CLIENT (cclient)->wm_client;
+  guint                 *rate = cmgr->priv->update_rate;
+  guint                  fps = cclient->priv->max_fps;
+
+  if ((cclient->priv->flags & MBWMCompMgrClutterClientDontUpdate) &&
+      !(cclient->priv->flags & MBWMCompMgrClutterClientIgnoreDontUpdate))
+    return UPDATE_DELAY_FROZEN;
+
+#define LOWER_TO(limit) \
+  if ((limit) && (!fps || (limit) < fps)) fps = (limit)
+
+  if (rate[MBWMCompMgrClutterRateUnfocused] &&
+      c != c->wmref->focused_client)
+    LOWER_TO (rate[MBWMCompMgrClutterRateUnfocused]);
+
+  if (rate[MBWMCompMgrClutterRatePartiallyOccluded] &&
+      mb_wm_comp_mgr_clutter_client_is_partially_occluded (c))
+    LOWER_TO (rate[MBWMCompMgrClutterRatePartiallyOccluded]);
+
+  if (rate[MBWMCompMgrClutterRateScaled] &&
+      mb_wm_comp_mgr_clutter_client_is_scaled (cclient))
+    LOWER_TO (rate[MBWMCompMgrClutterRateScaled]);
+
+#undef LOWER_TO
+
+  return fps ? 1000 / fps : UPDATE_DELAY_NONE;
+}
+
+static void
+mb_wm_comp_mgr_clutter_client_update (MBWMCompMgrClutterClient *cclient)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR_CLIENT (cclient)->wm;
+
+  cclient->priv->last_update = g_get_monotonic_time ();
+
+  /* FIXME: As Adam said, reason for this X error should be discovered
+   * and avoided */
+  MBWM_SPAN_BEGIN ("comp-repair", NULL,
+		   MB_WM_COMP_MGR_CLIENT (cclient)->wm_client->window->xwindow);
+  mb_wm_util_async_trap_x_errors_warn (wm->xdpy, "");
+  mb_wm_comp_mgr_clutter_client_repair_real (MB_WM_COMP_MGR_CLIENT (cclient),
+					     cclient->priv->window_damage);
+  mb_wm_util_async_untrap_x_errors();
+  MBWM_SPAN_END ("comp-repair");
+}
+
+/* Applies the damage held back by the rate limit */
+static Bool
+mb_wm_comp_mgr_clutter_client_update_timeout (void *userdata)
+{
+  MBWMCompMgrClutterClient *cclient = userdata;
+
+  cclient->priv->update_timeout_id = 0;
+
+  if (cclient->priv->actor && !cclient->priv->damage_handling_off &&
+      cclient->priv->window_damage)
+    {
+      mb_wm_comp_mgr_clutter_client_update (cclient);
+      XFlush (MB_WM_COMP_MGR_CLIENT (cclient)->wm->xdpy);
+    }
+
+  return False;
+}
+
 static Bool
 mb_wm_comp_mgr_clutter_handle_damage (XDamageNotifyEvent * de,
 				      MBWMCompMgr        * mgr)
@@ -906,17 +1434,38 @@ mb_wm_comp_mgr_clutter_handle_damage (XDamageNotifyEvent * de,
 
   if (!cclient->priv->damage_handling_off)
     {
-      Damage damage;
+      int    delay;
+      gint64 since;
 
       if (!cclient->priv->actor ||
-          ((cclient->priv->flags & MBWMCompMgrClutterClientDontUpdate) &&
-           !(cclient->priv->flags & MBWMCompMgrClutterClientIgnoreDontUpdate))
-	  )
+	  (delay = mb_wm_comp_mgr_clutter_client_update_delay (
+				MB_WM_COMP_MGR_CLUTTER (mgr), cclient))
+	  == UPDATE_DELAY_FROZEN)
         {
           XDamageSubtract (wm->xdpy, cclient->priv->window_damage, None, None);
           return False;
         }
 
+      /*
+       * Too soon: leave the damage to accumulate in the damage object,
+       * which will not report again until we subtract it, and apply it
+       * all once the client is allowed another update.
+       */
+      since = (g_get_monotonic_time () - cclient->priv->last_update) / 1000;
+
+      if (cclient->priv->update_timeout_id)
+	return False;
+
+      if (delay != UPDATE_DELAY_NONE && since < delay)
+	{
+	  cclient->priv->update_timeout_id =
+	    mb_wm_main_context_timeout_handler_add (wm->main_ctx,
+			delay - since,
+			mb_wm_comp_mgr_clutter_client_update_timeout,
+			cclient);
+	  return False;
+	}
+
       MBWM_NOTE (COMPOSITOR,
 		 "Repairing window %lx, geometry %d,%d;%dx%d; more %d\n",
 		 de->drawable,
@@ -929,63 +1478,449 @@ mb_wm_comp_mgr_clutter_handle_damage (XDamageNotifyEvent * de,
        * In full-screen mode we are not watching the frame window. When the
        * full-screen mode is set we only watch the frame window.
        */
-      damage = cclient->priv->window_damage;
-
-      /* FIXME: As Adam said, reason for this X error should be discovered
-       * and avoided */
-      mb_wm_util_async_trap_x_errors_warn (wm->xdpy, "");
-      mb_wm_comp_mgr_clutter_client_repair_real (c->cm_client, damage);
-      mb_wm_util_async_untrap_x_errors();
+      mb_wm_comp_mgr_clutter_client_update (cclient);
     }
 
   return False;
 }
 
+/*
+ * Puts the client actors of @group, given bottom to top in @managed, into
+ * that order above any other actor of the group, as raising them one by
+ * one would. Nothing is done if the group is in that order already;
+ * otherwise the longest run of actors already in the right relative order
+ * is left where it is, so only the actors that are out of place get moved.
+ */
+static void
+mb_wm_comp_mgr_clutter_restack_group (ClutterActor *group,
+				      GPtrArray    *managed)
+{
+  GHashTable   * index;
+  GList        * children, * l;
+  ClutterActor** actors;
+  int          * pos, * len, * prev;
+  Bool         * keep;
+  Bool           in_order = TRUE;
+  int            i, j, n, best = 0;
+
+  children = clutter_container_get_children (CLUTTER_CONTAINER (group));
+  index = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < (int) managed->len; ++i)
+    g_hash_table_insert (index, g_ptr_array_index (managed, i),
+			 GINT_TO_POINTER (-1));
+
+  /* The wanted order: everything else first, then the client actors */
+  n = g_list_length (children);
+  actors = g_new (ClutterActor *, n);
+
+  for (l = children, i = 0; l; l = l->next)
+    if (!g_hash_table_lookup (index, l->data))
+      actors[i++] = l->data;
+
+  for (j = 0; j < (int) managed->len && i < n; ++j)
+    actors[i++] = g_ptr_array_index (managed, j);
+
+  for (l = children, i = 0; l; l = l->next, ++i)
+    {
+      if (l->data != actors[i])
+	in_order = FALSE;
+
+      g_hash_table_insert (index, l->data, GINT_TO_POINTER (i));
+    }
+
+  g_list_free (children);
+
+  if (in_order || n < 2)
+    {
+      g_hash_table_destroy (index);
+      g_free (actors);
+      return;
+    }
+
+  pos  = g_new (int, n);
+  len  = g_new (int, n);
+  prev = g_new (int, n);
+  keep = g_new0 (Bool, n);
+
+  /* Longest increasing subsequence of the current positions */
+  for (i = 0; i < n; ++i)
+    {
+      pos[i]  = GPOINTER_TO_INT (g_hash_table_lookup (index, actors[i]));
+      len[i]  = 1;
+      prev[i] = -1;
+
+      for (j = 0; j < i; ++j)
+	if (pos[j] < pos[i] && len[j] + 1 > len[i])
+	  {
+	    len[i]  = len[j] + 1;
+	    prev[i] = j;
+	  }
+
+      if (len[i] > len[best])
+	best = i;
+    }
+
+  for (i = best; i >= 0; i = prev[i])
+    keep[i] = True;
+
+  for (i = 0; i < n; ++i)
+    {
+      if (keep[i])
+	continue;
+
+      MBWM_NOTE (COMPOSITOR, "moving actor %p", actors[i]);
+
+      if (i > 0)
+	clutter_actor_raise (actors[i], actors[i - 1]);
+      else
+	{
+	  for (j = 1; !keep[j]; ++j)
+	    ;
+
+	  clutter_actor_lower (actors[i], actors[j]);
+	}
+    }
+
+  g_hash_table_destroy (index);
+  g_free (actors);
+  g_free (pos);
+  g_free (len);
+  g_free (prev);
+  g_free (keep);
+}
+
 static void
 mb_wm_comp_mgr_clutter_restack_real (MBWMCompMgr *mgr)
 {
   MBWindowManager    * wm = mgr->wm;
   MBWMCompMgrClutter * cmgr = MB_WM_COMP_MGR_CLUTTER (mgr);
   MBWMList           * l;
-  int                  i = 0;
+  GPtrArray          * managed;
+  int                  desktop = 0;
 
-  l = cmgr->priv->desktops;
+  if (mb_wm_stack_empty (wm))
+    return;
 
-  if (!mb_wm_stack_empty (wm))
+  managed = g_ptr_array_new ();
+
+  for (l = cmgr->priv->desktops; l; l = l->next, ++desktop)
     {
+      ClutterActor          * group = l->data;
       MBWindowManagerClient * c;
 
-      while (l)
+      g_ptr_array_set_size (managed, 0);
+
+      mb_wm_stack_enumerate (wm, c)
 	{
-	  ClutterActor *desktop = l->data;
-	  ClutterActor * prev = NULL;
+	  MBWMCompMgrClutterClient * cc;
+	  ClutterActor             * a;
 
-	  mb_wm_stack_enumerate (wm, c)
-	    {
-	      MBWMCompMgrClutterClient * cc;
-	      ClutterActor             * a;
+	  if (mb_wm_client_get_desktop (c) != desktop || !c->cm_client)
+	    continue;
 
-	      if (mb_wm_client_get_desktop (c) != i)
-		continue;
+	  cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
 
-	      cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+	  a = cc->priv->actor;
 
-	      a = cc->priv->actor;
+	  if (!a ||
+	      clutter_actor_get_parent (a) != group ||
+	      cc->priv->flags & MBWMCompMgrClutterClientDontShow)
+	    continue;
 
-	      if (!a ||
-		  clutter_actor_get_parent (a) != desktop ||
-		  cc->priv->flags & MBWMCompMgrClutterClientDontShow)
-		continue;
+	  g_ptr_array_add (managed, a);
+	}
 
-	      clutter_actor_raise (a, prev);
+      mb_wm_comp_mgr_clutter_restack_group (group, managed);
+    }
 
-	      prev = a;
-	    }
+  g_ptr_array_free (managed, TRUE);
+}
 
-	  l = l->next;
-	  ++i;
+/*
+ * Stops a client nobody can see from costing anything: its actor is hidden
+ * and its damage object destroyed, which also releases the pixmap.
+ */
+static void
+mb_wm_comp_mgr_clutter_client_cull (MBWMCompMgrClutterClient *cclient)
+{
+  MBWM_NOTE (COMPOSITOR, "culling %lx",
+	     MB_WM_COMP_MGR_CLIENT (cclient)->wm_client->window->xwindow);
+
+  clutter_actor_hide (cclient->priv->actor);
+  mb_wm_comp_mgr_clutter_client_track_damage (cclient, False);
+
+  cclient->priv->culled = True;
+}
+
+/* Undoes the above; turning damage tracking back on refetches the texture */
+static void
+mb_wm_comp_mgr_clutter_client_uncull (MBWMCompMgrClutterClient *cclient)
+{
+  MBWM_NOTE (COMPOSITOR, "unculling %lx",
+	     MB_WM_COMP_MGR_CLIENT (cclient)->wm_client->window->xwindow);
+
+  cclient->priv->culled = False;
+
+  mb_wm_comp_mgr_clutter_client_track_damage (cclient, True);
+
+  if (!(cclient->priv->flags & MBWMCompMgrClutterClientDontShow))
+    clutter_actor_show (cclient->priv->actor);
+}
+
+/* What keeping the client's pixmap bound costs us, roughly */
+static gsize
+mb_wm_comp_mgr_clutter_client_texture_size (MBWMCompMgrClutterClient *cclient)
+{
+  MBWindowManagerClient *c = MB_WM_COMP_MGR_CLIENT (cclient)->wm_client;
+
+  if (!cclient->priv->texture || !cclient->priv->bound ||
+      cclient->priv->evicted || cclient->priv->damage_handling_off ||
+      cclient->priv->unredirected)
+    return 0;
+
+  return (gsize) c->window->geometry.width * c->window->geometry.height *
+    (c->window->depth > 16 ? 4 : 2);
+}
+
+static gint
+mb_wm_comp_mgr_clutter_compare_last_visible (gconstpointer a, gconstpointer b)
+{
+  const MBWMCompMgrClutterClient *ca = a, *cb = b;
+
+  if (ca->priv->last_visible == cb->priv->last_visible)
+    return 0;
+
+  return ca->priv->last_visible < cb->priv->last_visible ? -1 : 1;
+}
+
+/*
+ * Whether @actor and all its ancestors up to the stage are shown. The stage
+ * itself is left out, as it is only hidden while a client is unredirected.
+ */
+static Bool
+mb_wm_comp_mgr_clutter_actor_is_shown (ClutterActor *actor)
+{
+  ClutterActor *stage = clutter_stage_get_default ();
+
+  for (; actor && actor != stage; actor = clutter_actor_get_parent (actor))
+    if (!CLUTTER_ACTOR_IS_VISIBLE (actor))
+      return False;
+
+  return actor == stage;
+}
+
+/*
+ * Keeps the pixmaps bound to textures within the texture budget by
+ * releasing those of the clients that have been out of sight the longest;
+ * anything that is shown again gets its texture back.
+ */
+static void
+mb_wm_comp_mgr_clutter_enforce_texture_budget (MBWMCompMgrClutter *cmgr)
+{
+  MBWindowManager       * wm = MB_WM_COMP_MGR (cmgr)->wm;
+  MBWindowManagerClient * c;
+  GList                 * hidden = NULL, * l;
+  gint64                  now = g_get_monotonic_time ();
+  gsize                   total = 0;
+  unsigned long           n_bound = 0;
+
+  mb_wm_stack_enumerate (wm, c)
+    {
+      MBWMCompMgrClutterClient * cc;
+      ClutterActor             * a;
+      gsize                      size;
+
+      if (!c->cm_client)
+	continue;
+
+      cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+      a  = cc->priv->actor;
+
+      if (!a || !cc->priv->texture ||
+	  !(cc->priv->flags & MBWMCompMgrClutterClientMapped))
+	continue;
+
+      if (mb_wm_comp_mgr_clutter_actor_is_shown (a))
+	{
+	  cc->priv->last_visible = now;
+
+	  if (cc->priv->evicted)
+	    mb_wm_comp_mgr_clutter_client_restore_texture (cc);
+	}
+      else if (!(cc->priv->flags & MBWMCompMgrClutterClientEffectRunning))
+	hidden = g_list_prepend (hidden, cc);
+
+      size   = mb_wm_comp_mgr_clutter_client_texture_size (cc);
+      total += size;
+
+      if (size)
+	n_bound++;
+    }
+
+  if (cmgr->priv->texture_budget && total > cmgr->priv->texture_budget)
+    {
+      hidden = g_list_sort (hidden,
+			    mb_wm_comp_mgr_clutter_compare_last_visible);
+
+      for (l = hidden; l && total > cmgr->priv->texture_budget; l = l->next)
+	{
+	  MBWMCompMgrClutterClient *cc = l->data;
+	  gsize                     size;
+
+	  size = mb_wm_comp_mgr_clutter_client_texture_size (cc);
+
+	  if (!size)
+	    continue;
+
+	  MBWM_NOTE (COMPOSITOR, "evicting texture of %lx, %lu bytes",
+		     MB_WM_COMP_MGR_CLIENT (cc)->wm_client->window->xwindow,
+		     (unsigned long) size);
+
+	  clutter_x11_texture_pixmap_set_window (
+		CLUTTER_X11_TEXTURE_PIXMAP (cc->priv->texture), 0);
+	  cc->priv->evicted = True;
+
+	  total -= size;
+	  n_bound--;
 	}
     }
+
+  g_list_free (hidden);
+
+  mb_wm_stats_mem_set (MBWMStatsMemTextures, n_bound, total);
+}
+
+/*
+ * Limits the memory used by the pixmaps of clients that are not shown to
+ * @bytes, or lifts the limit if 0.  Can also be set in kilobytes with the
+ * MB_TEXTURE_BUDGET_KB environment variable.
+ */
+void
+mb_wm_comp_mgr_clutter_set_texture_budget (MBWMCompMgrClutter *cmgr,
+					   gsize               bytes)
+{
+  cmgr->priv->texture_budget = bytes;
+
+  if (!MB_WM_COMP_MGR (cmgr)->disabled)
+    mb_wm_comp_mgr_clutter_enforce_texture_budget (cmgr);
+}
+
+/*
+ * Caps how often the textures of the clients falling under @rule are
+ * updated, in frames per second; 0 lifts the cap.  Damage coming in faster
+ * is merged and applied at the allowed rate.
+ */
+void
+mb_wm_comp_mgr_clutter_set_update_rate (MBWMCompMgrClutter        *cmgr,
+					MBWMCompMgrClutterRateRule rule,
+					guint                      fps)
+{
+  g_return_if_fail (rule < MBWMCompMgrClutterRateRuleCount);
+
+  cmgr->priv->update_rate[rule] = fps;
+}
+
+/*
+ * Caps the update rate of this client alone, in frames per second; 0 leaves
+ * it to the rules.  Freezing it altogether is what the DontUpdate flag does.
+ */
+void
+mb_wm_comp_mgr_clutter_client_set_max_fps (MBWMCompMgrClutterClient *cclient,
+					   guint                     fps)
+{
+  cclient->priv->max_fps = fps;
+}
+
+/* Whether the actor of the client is on the desktop group it belongs to */
+static Bool
+mb_wm_comp_mgr_clutter_client_on_desktop (MBWMCompMgrClutter    *cmgr,
+					  MBWindowManagerClient *c,
+					  ClutterActor          *a)
+{
+  int desktop = mb_wm_client_get_desktop (c);
+
+  return clutter_actor_get_parent (a) ==
+    mb_wm_comp_mgr_clutter_get_nth_desktop (cmgr, desktop < 0 ? 0 : desktop);
+}
+
+/*
+ * Called at the end of every mb_wm_sync(), after the occlusion pass. Only
+ * clients we are in full control of are culled: their actor must be on
+ * our desktop group, shown, with damage tracking on, and not in the middle
+ * of an effect.  A culled client the shell has since taken off the desktop
+ * group is given back its pixmap and shown again.
+ */
+static void
+mb_wm_comp_mgr_clutter_render_real (MBWMCompMgr *mgr)
+{
+  MBWindowManager       * wm = mgr->wm;
+  MBWMCompMgrClutter    * cmgr = MB_WM_COMP_MGR_CLUTTER (mgr);
+  MBWindowManagerClient * c;
+
+  mb_wm_stack_enumerate (wm, c)
+    {
+      MBWMCompMgrClutterClient * cc;
+      ClutterActor             * a;
+
+      if (!c->cm_client)
+	continue;
+
+      cc = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+      a  = cc->priv->actor;
+
+      if (!a || !(cc->priv->flags & MBWMCompMgrClutterClientMapped))
+	continue;
+
+      if (cc->priv->culled)
+	{
+	  if (!cmgr->priv->culling ||
+	      !mb_wm_client_is_occluded (c) ||
+	      (cc->priv->flags & MBWMCompMgrClutterClientEffectRunning) ||
+	      !mb_wm_comp_mgr_clutter_client_on_desktop (cmgr, c, a))
+	    mb_wm_comp_mgr_clutter_client_uncull (cc);
+	  else
+	    /* map_notify() may have shown it again in the meantime */
+	    clutter_actor_hide (a);
+
+	  continue;
+	}
+
+      if (!cmgr->priv->culling ||
+	  !mb_wm_client_is_occluded (c) ||
+	  !CLUTTER_ACTOR_IS_VISIBLE (a) ||
+	  cc->priv->damage_handling_off || !cc->priv->window_damage ||
+	  cc->priv->unredirected ||
+	  (cc->priv->flags & (MBWMCompMgrClutterClientEffectRunning |
+			      MBWMCompMgrClutterClientDontShow)) ||
+	  !mb_wm_comp_mgr_clutter_client_on_desktop (cmgr, c, a))
+	continue;
+
+      mb_wm_comp_mgr_clutter_client_cull (cc);
+    }
+
+  mb_wm_comp_mgr_clutter_enforce_texture_budget (cmgr);
+  mb_wm_comp_mgr_clutter_update_unredirection (cmgr);
+}
+
+/*
+ * Culling of occluded clients is off by default, as a shell may show client
+ * actors outside of the normal stacking (a task switcher, say); it can be
+ * turned on here or by setting MB_OCCLUSION_CULLING in the environment.
+ * Turning it off restores all the culled clients.
+ */
+void
+mb_wm_comp_mgr_clutter_set_culling (MBWMCompMgrClutter *cmgr, Bool enabled)
+{
+  MBWMCompMgr *mgr = MB_WM_COMP_MGR (cmgr);
+
+  if (!cmgr->priv->culling == !enabled)
+    return;
+
+  cmgr->priv->culling = enabled ? True : False;
+
+  if (!mgr->disabled)
+    mb_wm_comp_mgr_clutter_render_real (mgr);
 }
 
 MBWMList *
@@ -1065,6 +2000,9 @@ mb_wm_comp_mgr_clutter_select_desktop (MBWMCompMgr * mgr,
 
       l = l->next;
     }
+
+  /* Bring back the textures evicted from the desktop now shown */
+  mb_wm_comp_mgr_clutter_enforce_texture_budget (cmgr);
 }
 
 /* Enable/disable damage tracking for a client */
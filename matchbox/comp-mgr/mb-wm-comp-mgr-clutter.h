@@ -51,6 +51,16 @@ typedef enum
   MBWMCompMgrClutterClientIgnoreDontUpdate = (1<<6),
 } MBWMCompMgrClutterClientFlags;
 
+/* Rules limiting how often the texture of a client gets updated */
+typedef enum
+{
+  MBWMCompMgrClutterRateUnfocused = 0,
+  MBWMCompMgrClutterRatePartiallyOccluded,
+  MBWMCompMgrClutterRateScaled,
+
+  MBWMCompMgrClutterRateRuleCount
+} MBWMCompMgrClutterRateRule;
+
 /**
  * An MBWMCompMgr which renders using Clutter.
  */
@@ -131,6 +141,26 @@ mb_wm_comp_mgr_clutter_set_client_redirection (MBWMCompMgrClient *client,
 Bool
 mb_wm_comp_mgr_clutter_client_is_unredirected (MBWMCompMgrClient *client);
 
+void
+mb_wm_comp_mgr_clutter_set_culling (MBWMCompMgrClutter *cmgr, Bool enabled);
+
+void
+mb_wm_comp_mgr_clutter_set_texture_budget (MBWMCompMgrClutter *cmgr,
+					   gsize               bytes);
+
+void
+mb_wm_comp_mgr_clutter_set_update_rate (MBWMCompMgrClutter        *cmgr,
+					MBWMCompMgrClutterRateRule rule,
+					guint                      fps);
+
+void
+mb_wm_comp_mgr_clutter_client_set_max_fps (MBWMCompMgrClutterClient *cclient,
+					   guint                     fps);
+
+void
+mb_wm_comp_mgr_clutter_set_auto_unredirect (MBWMCompMgrClutter *cmgr,
+					    Bool                enabled);
+
 Window
 mb_wm_comp_mgr_clutter_get_overlay_window (MBWMCompMgrClutter *cmgr);
 void
@@ -56,6 +56,10 @@
 #include <X11/cursorfont.h>
 #endif
 
+#ifdef HAVE_XEXT
+#include <X11/extensions/shape.h>
+#endif
+
 #define FALLBACK_THEME_PATH "/usr/share/themes/default"
 
 static void
@@ -315,13 +319,16 @@ mb_wm_destroy (MBWMObject *this)
 
       l = l->next;
 
-      free (old);
+      mb_wm_util_list_free_item (old);
     }
 
   mb_wm_object_unref (MB_WM_OBJECT (wm->root_win));
   mb_wm_object_unref (MB_WM_OBJECT (wm->theme));
   mb_wm_object_unref (MB_WM_OBJECT (wm->layout));
   mb_wm_object_unref (MB_WM_OBJECT (wm->main_ctx));
+
+  if (wm->prop_cache)
+    g_hash_table_destroy (wm->prop_cache);
 }
 
 static int
@@ -524,6 +531,32 @@ mb_wm_handle_unmap_notify (XUnmapEvent          *xev,
   return True;
 }
 
+#ifdef HAVE_XEXT
+/* The cached shape of the window is stale now */
+static Bool
+mb_wm_handle_shape_notify (XShapeEvent             *xev,
+			   void                    *userdata)
+{
+  MBWindowManager       *wm = (MBWindowManager*)userdata;
+  MBWindowManagerClient *client;
+
+  if (xev->kind != ShapeBounding)
+    return True;
+
+  client = mb_wm_managed_client_from_xwindow (wm, xev->window);
+
+  if (client)
+    {
+      mb_wm_client_window_invalidate_shape (client->window);
+
+      /* A shaped client no longer counts as opaque */
+      mb_wm_display_sync_queue (wm, MBWMSyncVisibility);
+    }
+
+  return True;
+}
+#endif
+
 static Bool
 mb_wm_handle_property_notify (XPropertyEvent          *xev,
 			      void                    *userdata)
@@ -536,21 +569,29 @@ mb_wm_handle_property_notify (XPropertyEvent          *xev,
     {
       if (xev->atom == wm->atoms[MBWM_ATOM_MB_THEME])
 	{
-	  Atom type;
+	  MBWMCookie cookie;
+	  Atom type = None;
 	  int  format;
-	  unsigned long items;
+	  unsigned long items = 0;
 	  unsigned long left;
-	  unsigned char *theme_path;
+	  unsigned char *theme_path = NULL;
+	  int            x_error_code = 0;
 	  Bool           same_path;
 
-	  XGetWindowProperty (wm->xdpy, wm->root_win->xwindow,
-			      xev->atom, 0, 8192, False,
-			      XA_STRING, &type, &format,
-			      &items, &left,
-			      &theme_path);
+	  cookie = mb_wm_property_req (wm, wm->root_win->xwindow,
+				       xev->atom, 0, 8192, False,
+				       XA_STRING);
+	  mb_wm_util_sync (wm->xdpy, False);
+	  mb_wm_property_reply (wm, cookie, &type, &format,
+				&items, &left,
+				&theme_path, &x_error_code);
 
-	  if (!type || !items)
-	    return True;
+	  if (x_error_code || !type || !items)
+	    {
+	      if (theme_path)
+		XFree (theme_path);
+	      return True;
+	    }
 
 	  /*
 	   * With protecting/unprotecting of the theme we can sense if the WM
@@ -868,6 +909,7 @@ mb_wm_handle_map_notify   (XMapEvent  *xev,
   MBWMClientWindow *win = NULL;
   XWindowAttributes attrs = { 0 };
   int err;
+  gint64 start;
 
   g_debug ("%s: @@@@ Map Notify for %lx @@@@", __func__, xev->window);
 
@@ -924,7 +966,9 @@ mb_wm_handle_map_notify   (XMapEvent  *xev,
   /* We don't care about X errors here, because they will be reported
    * in the return value of XGetWindowAttributes. */
   mb_wm_util_async_trap_x_errors (wm->xdpy);
+  start = g_get_monotonic_time ();
   err = XGetWindowAttributes(wm->xdpy, xev->window, &attrs);
+  mb_wm_stats_round_trip (start);
   mb_wm_util_async_untrap_x_errors();
   if (!err)
     {
@@ -982,9 +1026,13 @@ mb_wm_handle_map_request (XMapRequestEvent  *xev,
   MBWindowManagerClass  *wm_class =
     MB_WINDOW_MANAGER_CLASS (MB_WM_OBJECT_GET_CLASS (wm));
   MBWMClientWindow *win = NULL;
+  gint64            start = wm->main_ctx->event_start;
 
   MBWM_MARK();
 
+  if (!start)
+    start = g_get_monotonic_time ();
+
   g_debug ("%s: @@@@ Map Request for %lx @@@@", __func__, xev->window);
 
   if (mb_wm_is_my_window (wm, xev->window, &client))
@@ -1019,6 +1067,8 @@ mb_wm_handle_map_request (XMapRequestEvent  *xev,
 
   mb_wm_manage_client (wm, client, True);
 
+  mb_wm_stats_probe_handled (xev->window, MBWMStatsProbeMap, start);
+
   return True;
 }
 
@@ -1119,20 +1169,21 @@ mb_wm_sync (MBWindowManager *wm)
 {
   /* Sync all changes to display */
   MBWindowManagerClient *client = NULL;
-#ifdef TIME_MB_WM_SYNC
-  GTimer *timer = g_timer_new();
-#endif
   MBWM_MARK();
   MBWM_TRACE ();
 
+  mb_wm_stats_sync_begin (wm);
+
   XGrabServer(wm->xdpy);
 
   /* First of all, make sure stack is correct */
   if (wm->sync_type & MBWMSyncStacking)
     {
+      mb_wm_stats_sync_phase (wm, MBWMStatsPhaseStackEnsure);
       mb_wm_stack_ensure (wm);
 
 #if ENABLE_COMPOSITE
+      mb_wm_stats_sync_phase (wm, MBWMStatsPhaseCompRestack);
       if (wm->comp_mgr && mb_wm_comp_mgr_enabled (wm->comp_mgr))
 	mb_wm_comp_mgr_restack (wm->comp_mgr);
 #endif
@@ -1141,10 +1192,12 @@ mb_wm_sync (MBWindowManager *wm)
   /* Size stuff first assume newly managed windows unmapped ?
    *
    */
+  mb_wm_stats_sync_phase (wm, MBWMStatsPhaseLayout);
   if (wm->layout && (wm->sync_type & MBWMSyncGeometry))
     mb_wm_layout_update (wm->layout);
 
   /* Create the actual windows */
+  mb_wm_stats_sync_phase (wm, MBWMStatsPhaseRealize);
   mb_wm_stack_enumerate(wm, client)
     if (!mb_wm_client_is_realized (client))
       mb_wm_client_realize (client);
@@ -1155,11 +1208,18 @@ mb_wm_sync (MBWindowManager *wm)
    * If an item in the stack needs visibilty sync, then we have to force it
    * for all items that are above it on the stack.
    */
+  mb_wm_stats_sync_phase (wm, MBWMStatsPhaseDisplaySync);
   mb_wm_stack_enumerate(wm, client)
     if (mb_wm_client_needs_sync (client))
       mb_wm_client_display_sync (client);
 
+  /* Everything is where it is going to be, see who can be seen */
+  mb_wm_stats_sync_phase (wm, MBWMStatsPhaseOcclusion);
+  if (!wm->occlusion_valid)
+    mb_wm_stack_update_occlusion (wm);
+
 #if ENABLE_COMPOSITE
+  mb_wm_stats_sync_phase (wm, MBWMStatsPhaseCompRender);
   if (mb_wm_comp_mgr_enabled (wm->comp_mgr))
     mb_wm_comp_mgr_render (wm->comp_mgr);
 #endif
@@ -1169,7 +1229,10 @@ mb_wm_sync (MBWindowManager *wm)
    *        clients mapping below existing ones.
   */
   if (wm->sync_type & MBWMSyncStacking)
-    stack_sync_to_display (wm);
+    {
+      mb_wm_stats_sync_phase (wm, MBWMStatsPhaseRestack);
+      stack_sync_to_display (wm);
+    }
 
   /* FIXME: New clients now managed will likely need some propertys
    *        synced up here.
@@ -1185,10 +1248,7 @@ mb_wm_sync (MBWindowManager *wm)
       mb_wm_focus_client_as_stacked (wm, NULL);
     }
 
-#ifdef TIME_MB_WM_SYNC
-  g_debug("mb_wm_sync: %f", g_timer_elapsed(timer,0));
-  g_timer_destroy(timer);
-#endif
+  mb_wm_stats_sync_end (wm);
 }
 
 static void
@@ -1219,10 +1279,9 @@ mb_wm_update_root_win_lists (MBWindowManager *wm)
 	    wins[cnt++] = c->window->xwindow;
 	}
 
-      XChangeProperty(wm->xdpy, root_win,
-		      wm->atoms[MBWM_ATOM_NET_CLIENT_LIST_STACKING],
-		      XA_WINDOW, 32, PropModeReplace,
-		      (unsigned char *)wins, cnt);
+      mb_wm_property_change (wm, root_win,
+			     wm->atoms[MBWM_ATOM_NET_CLIENT_LIST_STACKING],
+			     XA_WINDOW, 32, wins, cnt);
 
       /* Update _NET_CLIENT_LIST but with 'age' order rather than stacking */
       cnt = 0;
@@ -1235,23 +1294,20 @@ mb_wm_update_root_win_lists (MBWindowManager *wm)
 	  l = l->next;
 	}
 
-      XChangeProperty(wm->xdpy, root_win,
-		      wm->atoms[MBWM_ATOM_NET_CLIENT_LIST] ,
-		      XA_WINDOW, 32, PropModeReplace,
-		      (unsigned char *)wins, cnt);
+      mb_wm_property_change (wm, root_win,
+			     wm->atoms[MBWM_ATOM_NET_CLIENT_LIST],
+			     XA_WINDOW, 32, wins, cnt);
     }
   else
     {
       /* No managed windows */
-      XChangeProperty(wm->xdpy, root_win,
-		      wm->atoms[MBWM_ATOM_NET_CLIENT_LIST_STACKING] ,
-		      XA_WINDOW, 32, PropModeReplace,
-		      NULL, 0);
+      mb_wm_property_change (wm, root_win,
+			     wm->atoms[MBWM_ATOM_NET_CLIENT_LIST_STACKING],
+			     XA_WINDOW, 32, NULL, 0);
 
-      XChangeProperty(wm->xdpy, root_win,
-		      wm->atoms[MBWM_ATOM_NET_CLIENT_LIST] ,
-		      XA_WINDOW, 32, PropModeReplace,
-		      NULL, 0);
+      mb_wm_property_change (wm, root_win,
+			     wm->atoms[MBWM_ATOM_NET_CLIENT_LIST],
+			     XA_WINDOW, 32, NULL, 0);
     }
 }
 
@@ -1491,6 +1547,9 @@ void
 mb_wm_display_sync_queue (MBWindowManager* wm, MBWMSyncType sync)
 {
   wm->sync_type |= sync;
+
+  if (sync & (MBWMSyncStacking | MBWMSyncGeometry | MBWMSyncVisibility))
+    wm->occlusion_valid = False;
 }
 
 static void
@@ -1498,66 +1557,108 @@ mb_wm_manage_preexisting_wins (MBWindowManager* wm)
 {
    unsigned int      nwins, i;
    Window            foowin1, foowin2, *wins;
-   XWindowAttributes attr;
+   MBWMCookie       *attr_cookies;
+   MBWMCookie      **prop_cookies;
+   gint64            start;
    MBWindowManagerClass * wm_class =
      MB_WINDOW_MANAGER_CLASS (MB_WM_OBJECT_GET_CLASS (wm));
 
    if (!wm_class->client_new)
      return;
 
+   start = g_get_monotonic_time ();
    XQueryTree(wm->xdpy, wm->root_win->xwindow,
 	      &foowin1, &foowin2, &wins, &nwins);
+   mb_wm_stats_round_trip (start);
+
+   /*
+    * Adopting the windows one at a time would cost a couple of round-trips
+    * each, which adds up when we are restarted with lots of windows open.
+    * So first ask for the attributes of all of them, then for the
+    * properties of the ones worth managing, and only then create the
+    * clients, in stacking order (XQueryTree() returns bottom to top).
+    */
+   attr_cookies = mb_wm_util_malloc0 (nwins * sizeof (MBWMCookie));
+   prop_cookies = mb_wm_util_malloc0 (nwins * sizeof (MBWMCookie *));
+
+   for (i = 0; i < nwins; i++)
+     attr_cookies[i] = mb_wm_xwin_get_attributes (wm, wins[i]);
+
+   mb_wm_util_sync (wm->xdpy, False);
 
    for (i = 0; i < nwins; i++)
      {
-       XGetWindowAttributes(wm->xdpy, wins[i], &attr);
+       MBWMClientWindowAttributes *attr;
+       int                         x_error_code;
+
+       attr = mb_wm_xwin_get_attributes_reply (wm, attr_cookies[i],
+					       &x_error_code);
+       if (!attr)
+	 continue;
 
        if (
 #if ! ENABLE_COMPOSITE
-	   !attr.override_redirect &&
+	   !attr->override_redirect &&
 #endif
-	   attr.map_state == IsViewable)
-	 {
-	   MBWMClientWindow      *win = NULL;
-	   MBWindowManagerClient *client = NULL;
+	   attr->map_state == IsViewable)
+	 prop_cookies[i] = mb_wm_client_window_prefetch (wm, wins[i]);
 
-	   win = mb_wm_client_window_new (wm, wins[i]);
+       XFree (attr);
+     }
 
-	   if (!win)
-	     continue;
+   mb_wm_util_sync (wm->xdpy, False);
 
-	   client = wm_class->client_new (wm, win);
+   for (i = 0; i < nwins; i++)
+     {
+       MBWMClientWindow      *win = NULL;
+       MBWindowManagerClient *client = NULL;
+
+       if (!prop_cookies[i])
+	 continue;
 
-	   if (client)
-	     {
-	       /*
-		* When we realize the client, we reparent the application
-		* window to the new frame, which generates an unmap event.
-		* We need to skip it.  On the other hand, don't skip the
-                * accompanying MapNotify this time.
-		*/
-	       client->skip_unmaps++;
-               client->skip_maps--;
-               MB_WM_DBG_SKIP_UNMAPS (client);
+       win = mb_wm_client_window_new_prefetched (wm, wins[i], prop_cookies[i]);
+       free (prop_cookies[i]);
+
+       if (!win)
+	 continue;
+
+       if (UNLIKELY (mb_wm_record_on))
+	 mb_wm_record_adopt (wm, wins[i], &win->geometry);
+
+       client = wm_class->client_new (wm, win);
+
+       if (client)
+	 {
+	   /*
+	    * When we realize the client, we reparent the application
+	    * window to the new frame, which generates an unmap event.
+	    * We need to skip it.  On the other hand, don't skip the
+	    * accompanying MapNotify this time.
+	    */
+	   client->skip_unmaps++;
+	   client->skip_maps--;
+	   MB_WM_DBG_SKIP_UNMAPS (client);
 
 #if ENABLE_COMPOSITE
-	       /*
-	        * Register the new client with the composite manager before
-	        * we call mb_wm_manage_client() -- this is necessary so that
-	        * we can process map notification on the frame.
-	        */
-	       if (wm->comp_mgr && mb_wm_comp_mgr_enabled (wm->comp_mgr))
-		 mb_wm_comp_mgr_register_client (wm->comp_mgr, client, False);
+	   /*
+	    * Register the new client with the composite manager before
+	    * we call mb_wm_manage_client() -- this is necessary so that
+	    * we can process map notification on the frame.
+	    */
+	   if (wm->comp_mgr && mb_wm_comp_mgr_enabled (wm->comp_mgr))
+	     mb_wm_comp_mgr_register_client (wm->comp_mgr, client, False);
 #endif
-	       mb_wm_manage_client(wm, client, False);
-	     }
-	   else
-	     mb_wm_object_unref (MB_WM_OBJECT (win));
+	   /* This only queues the sync, so all of them get synced at once */
+	   mb_wm_manage_client(wm, client, False);
 	 }
+       else
+	 mb_wm_object_unref (MB_WM_OBJECT (win));
      }
 
    wm->focus_after_stacking = True;
 
+   free (prop_cookies);
+   free (attr_cookies);
    XFree(wins);
 }
 
@@ -1601,26 +1702,21 @@ mb_wm_get_desktop_geometry (MBWindowManager *wm, MBGeometry * geom)
 void
 mb_wm_update_workarea (MBWindowManager *wm, const MBGeometry *geo)
 {
-  static long val[4];
+  long val[4];
 
-  if (val[0] == geo->x && val[1] == geo->y
-      && val[2] == geo->width && val[3] == geo->height)
-    return;
   val[0] = geo->x;
   val[1] = geo->y;
   val[2] = geo->width;
   val[3] = geo->height;
 
-  XChangeProperty(wm->xdpy, wm->root_win->xwindow,
-                  wm->atoms[MBWM_ATOM_NET_WORKAREA],
-		  XA_CARDINAL, 32, PropModeReplace,
-		  (unsigned char *)val, 4);
+  mb_wm_property_change (wm, wm->root_win->xwindow,
+			 wm->atoms[MBWM_ATOM_NET_WORKAREA],
+			 XA_CARDINAL, 32, val, 4);
 }
 
 static void
 mb_wm_update_root_win_rectangles (MBWindowManager *wm)
 {
-  Display * dpy = wm->xdpy;
   Window    root = wm->root_win->xwindow;
   MBGeometry d_geom;
   long val[2];
@@ -1630,9 +1726,8 @@ mb_wm_update_root_win_rectangles (MBWindowManager *wm)
 
   val[0] = wm->xdpy_width;
   val[1] = wm->xdpy_height;
-  XChangeProperty(dpy, root, wm->atoms[MBWM_ATOM_NET_DESKTOP_GEOMETRY],
-		  XA_CARDINAL, 32, PropModeReplace,
-		  (unsigned char *)val, 2);
+  mb_wm_property_change (wm, root, wm->atoms[MBWM_ATOM_NET_DESKTOP_GEOMETRY],
+			 XA_CARDINAL, 32, val, 2);
 }
 
 int
@@ -1642,6 +1737,124 @@ mb_wm_register_client_type (void)
   return ++type_cnt;
 }
 
+/*
+ * Startup is split into stages which are always timed (it is cheap); the
+ * per-stage wall time, X requests sent and XSyncs forced are reported at the
+ * end of mb_wm_init() when running with -startup-report.
+ *
+ * The stages run in a fixed order, each one needing what the ones before
+ * it set up: atoms come before anything that names them, the root window
+ * before the keys and cursor, the theme before the layout and compositor,
+ * and all of it before existing windows are adopted.  They do not overlap;
+ * the X setup is only left in flight while the theme is loaded.
+ */
+typedef struct MBWMStartupStage
+{
+  const char    *name;
+  gint64         usec;
+  unsigned long  requests;
+  unsigned long  syncs;
+} MBWMStartupStage;
+
+/* Of the window manager being initialised, freed by the report */
+static GArray          *startup_stages = NULL;
+static Bool             startup_stage_open = False;
+static gint64           startup_stage_start;
+static unsigned long    startup_stage_request;
+static unsigned long    startup_stage_sync;
+
+static void
+mb_wm_startup_begin (void)
+{
+  if (startup_stages)
+    g_array_set_size (startup_stages, 0);
+  else
+    startup_stages = g_array_new (FALSE, TRUE, sizeof (MBWMStartupStage));
+
+  startup_stage_open = False;
+}
+
+static void
+mb_wm_startup_stage_end (MBWindowManager *wm)
+{
+  MBWMStartupStage *stage;
+
+  if (!startup_stage_open)
+    return;
+
+  stage = &g_array_index (startup_stages, MBWMStartupStage,
+			  startup_stages->len - 1);
+
+  stage->usec  = g_get_monotonic_time () - startup_stage_start;
+  stage->syncs = mb_wm_util_sync_count () - startup_stage_sync;
+
+  if (wm->xdpy)
+    stage->requests = NextRequest (wm->xdpy) - startup_stage_request;
+
+  startup_stage_open = False;
+}
+
+/* Closes the current stage, if any, and starts timing the next one */
+static void
+mb_wm_startup_stage (MBWindowManager *wm, const char *name)
+{
+  MBWMStartupStage stage;
+
+  if (!startup_stages)
+    return;
+
+  mb_wm_startup_stage_end (wm);
+
+  memset (&stage, 0, sizeof (stage));
+  stage.name = name;
+  g_array_append_val (startup_stages, stage);
+
+  startup_stage_open    = True;
+  startup_stage_start   = g_get_monotonic_time ();
+  startup_stage_sync    = mb_wm_util_sync_count ();
+  startup_stage_request = wm->xdpy ? NextRequest (wm->xdpy) : 0;
+}
+
+static void
+mb_wm_startup_report (MBWindowManager *wm)
+{
+  gint64         usec = 0;
+  unsigned long  requests = 0, syncs = 0;
+  int            i;
+
+  if (!startup_stages)
+    return;
+
+  mb_wm_startup_stage_end (wm);
+
+  if (!(wm->flags & MBWindowManagerFlagStartupReport))
+    goto done;
+
+  fprintf (stderr, "matchbox: startup %-14s %10s %9s %6s\n",
+	   "stage", "ms", "requests", "syncs");
+
+  for (i = 0; i < (int) startup_stages->len; i++)
+    {
+      MBWMStartupStage *stage = &g_array_index (startup_stages,
+						MBWMStartupStage, i);
+
+      fprintf (stderr, "matchbox: startup %-14s %10.3f %9lu %6lu\n",
+	       stage->name, stage->usec / 1000.0,
+	       stage->requests, stage->syncs);
+
+      usec     += stage->usec;
+      requests += stage->requests;
+      syncs    += stage->syncs;
+    }
+
+  fprintf (stderr, "matchbox: startup %-14s %10.3f %9lu %6lu\n",
+	   "total", usec / 1000.0, requests, syncs);
+
+ done:
+  g_array_free (startup_stages, TRUE);
+  startup_stages = NULL;
+}
+
 static int
 mb_wm_init_xdpy (MBWindowManager * wm, const char * display)
 {
@@ -1715,19 +1928,33 @@ mb_wm_init (MBWindowManager * wm)
     wm->theme_path = FALLBACK_THEME_PATH;
   }
 
+  /*
+   * mb_window_manager_init() left its requests in flight, so the server
+   * works through them while we parse and decode the theme.
+   */
+  mb_wm_startup_stage (wm, "theme");
+
   mb_wm_set_theme_from_path (wm, wm->theme_path);
 
+  mb_wm_startup_stage (wm, "layout");
+
   MBWM_ASSERT (wm_class->layout_new);
 
   mb_wm_set_layout (wm, wm_class->layout_new (wm));
 
 #if ENABLE_COMPOSITE
+  mb_wm_startup_stage (wm, "compositor");
+
   if (wm_class->comp_mgr_new && mb_wm_theme_use_compositing_mgr (wm->theme))
     mb_wm_compositing_on (wm);
 #endif
 
+  mb_wm_startup_stage (wm, "adopt");
+
   mb_wm_manage_preexisting_wins (wm);
 
+  mb_wm_startup_report (wm);
+
   /*
    * Force an initial stack sync even when there are no managed windows (when
    * using compositor, this triggers call to MBWMCompMgr::restack(), allowing
@@ -1735,7 +1962,7 @@ mb_wm_init (MBWindowManager * wm)
    * might want to reorganize any auxiliar actors that it might have, depending
    * on whether the initial stack is empty or not.
    */
-  wm->sync_type |= MBWMSyncStacking;
+  mb_wm_display_sync_queue (wm, MBWMSyncStacking);
 }
 
 
@@ -1774,6 +2001,9 @@ mb_window_manager_init (MBWMObject *this, va_list vap)
   wm->argv = argv;
   wm->argc = argc;
 
+  mb_wm_startup_begin ();
+  mb_wm_startup_stage (wm, "display");
+
   if (argc && argv && wm_class->process_cmdline)
     wm_class->process_cmdline (wm);
 
@@ -1785,23 +2015,43 @@ mb_window_manager_init (MBWMObject *this, va_list vap)
 
   mb_wm_debug_init (getenv("MB_DEBUG"));
 
+  mb_wm_trace_init ();
+
   /* FIXME: Multiple screen handling */
 
   wm->xas_context = xas_context_new(wm->xdpy);
 
+  mb_wm_startup_stage (wm, "atoms");
+
   mb_wm_atoms_init(wm);
 
+  mb_wm_startup_stage (wm, "extensions");
+
 #if ENABLE_COMPOSITE
   if (!mb_wm_init_comp_extensions (wm))
     return 0;
 #endif
 
+#ifdef HAVE_XEXT
+  {
+    int shape_error;
+
+    if (!XShapeQueryExtension (wm->xdpy, &wm->shape_event_base, &shape_error))
+      wm->shape_event_base = 0;
+  }
+#endif
+
+  mb_wm_startup_stage (wm, "root-window");
+
   wm->root_win = mb_wm_root_window_get (wm);
 
   mb_wm_update_root_win_rectangles (wm);
 
   wm->main_ctx = mb_wm_main_context_new (wm);
 
+  mb_wm_stats_init (wm);
+  mb_wm_record_init (wm);
+
   mb_wm_main_context_x_event_handler_add (wm->main_ctx,
 			     None,
 			     MapRequest,
@@ -1858,13 +2108,25 @@ mb_window_manager_init (MBWMObject *this, va_list vap)
 			     (MBWMXEventFunc)mb_wm_handle_key_press,
 			     wm);
 
+#ifdef HAVE_XEXT
+  if (wm->shape_event_base)
+    mb_wm_main_context_x_event_handler_add (wm->main_ctx,
+			     None,
+			     wm->shape_event_base + ShapeNotify,
+			     (MBWMXEventFunc)mb_wm_handle_shape_notify,
+			     wm);
+#endif
+
+  mb_wm_startup_stage (wm, "keys");
+
   mb_wm_keys_init(wm);
 
+  mb_wm_startup_stage (wm, "cursor");
+
   /* set the cursor invisible */
 #if HAVE_XFIXES
   Cursor curs = XCreateFontCursor (wm->xdpy, XC_left_ptr);
   XDefineCursor (wm->xdpy, wm->root_win->xwindow, curs);
-  XSync(wm->xdpy, False);
   wm->flags |= MBWindowManagerFlagCursorVisible;
 #else
   {
@@ -1880,6 +2142,14 @@ mb_window_manager_init (MBWMObject *this, va_list vap)
 #endif
   wm_set_cursor_visibility(wm, FALSE);
 
+  /*
+   * None of the above needs an answer before we carry on, so rather than
+   * syncing just get it all to the server; mb_wm_init() will find it done.
+   */
+  XFlush (wm->xdpy);
+
+  mb_wm_startup_stage_end (wm);
+
   return 1;
 }
 
@@ -1906,6 +2176,8 @@ mb_wm_cmdline_help (const char *arg0, Bool quit)
   fprintf (f, "  -theme-always-reload  : Reload theme even if it matches the currently\n"
               "                          loaded theme.\n");
   fprintf (f, "  -theme theme          : Load the specified theme\n");
+  fprintf (f, "  -startup-report       : Print the time, X requests and XSyncs spent\n"
+              "                          in each stage of the start up.\n");
 
   if (quit)
     exit (0);
@@ -1928,6 +2200,10 @@ mb_wm_process_cmdline (MBWindowManager *wm)
 	{
 	  wm->flags |= MBWindowManagerFlagAlwaysReloadTheme;
 	}
+      else if (!strcmp(argv[i], "-startup-report"))
+	{
+	  wm->flags |= MBWindowManagerFlagStartupReport;
+	}
       else if (i < argc - 1)
 	{
 	  /* These need to have a value after the name parameter */
@@ -1957,11 +2233,16 @@ void
 mb_wm_activate_client (MBWindowManager * wm, MBWindowManagerClient *c)
 {
   MBWindowManagerClass  *wm_klass;
+  Window                 xwin = c ? MB_WM_CLIENT_XWIN (c) : None;
+  gint64                 start = g_get_monotonic_time ();
+
   wm_klass = MB_WINDOW_MANAGER_CLASS (MB_WM_OBJECT_GET_CLASS (wm));
 
   MBWM_ASSERT (wm_klass->client_activate);
 
   wm_klass->client_activate (wm, c);
+
+  mb_wm_stats_probe_handled (xwin, MBWMStatsProbeActivate, start);
 }
 
 
@@ -2036,10 +2317,9 @@ mb_wm_activate_client_real (MBWindowManager * wm, MBWindowManagerClient *c)
     {
       long card = is_desktop ? 1 : 0;
 
-      XChangeProperty(wm->xdpy, wm->root_win->xwindow,
-		      wm->atoms[MBWM_ATOM_NET_SHOWING_DESKTOP],
-		      XA_CARDINAL, 32, PropModeReplace,
-		      (unsigned char *)&card, 1);
+      mb_wm_property_change (wm, wm->root_win->xwindow,
+			     wm->atoms[MBWM_ATOM_NET_SHOWING_DESKTOP],
+			     XA_CARDINAL, 32, &card, 1);
     }
 
   mb_wm_display_sync_queue (wm, MBWMSyncStacking | MBWMSyncVisibility);
@@ -2147,6 +2427,7 @@ mb_wm_get_server_time (MBWindowManager *wm)
 {
   XEvent xevent;
   long data = 0;
+  gint64 start = g_get_monotonic_time ();
 
   /* zero-length append to get timestamp in the PropertyNotify */
   XChangeProperty (wm->xdpy, wm->root_win->xwindow,
@@ -2156,6 +2437,8 @@ mb_wm_get_server_time (MBWindowManager *wm)
 
   XIfEvent (wm->xdpy, &xevent, timestamp_predicate, (XPointer)wm);
 
+  mb_wm_stats_round_trip (start);
+
   return xevent.xproperty.time;
 }
 
@@ -2164,7 +2447,7 @@ static void
 mb_wm_set_layout (MBWindowManager *wm, MBWMLayout *layout)
 {
   wm->layout = layout;
-  wm->sync_type |= (MBWMSyncGeometry | MBWMSyncVisibility);
+  mb_wm_display_sync_queue (wm, MBWMSyncGeometry | MBWMSyncVisibility);
 }
 
 static void
@@ -2284,7 +2567,8 @@ mb_wm_set_theme (MBWindowManager *wm, MBWMTheme * theme)
     mb_wm_object_unref (MB_WM_OBJECT (wm->theme));
 
   wm->theme = theme;
-  wm->sync_type |= (MBWMSyncGeometry | MBWMSyncVisibility | MBWMSyncDecor);
+  mb_wm_display_sync_queue (wm, MBWMSyncGeometry | MBWMSyncVisibility |
+			    MBWMSyncDecor);
 
   /* When initializing the MBWindowManager object, the theme gets created
    * before the root window, so that the root window can interogate it,
@@ -2337,7 +2621,7 @@ mb_wm_compositing_on (MBWindowManager * wm)
   if (wm->comp_mgr && !mb_wm_comp_mgr_enabled (wm->comp_mgr))
     {
       mb_wm_comp_mgr_turn_on (wm->comp_mgr);
-      XSync (wm->xdpy, False);
+      mb_wm_util_sync (wm->xdpy, False);
     }
 #endif
 }
@@ -2454,7 +2738,7 @@ wm_set_cursor_visibility(MBWindowManager *wm, Bool visible)
     {
 #if HAVE_XFIXES
       XFixesShowCursor (wm->xdpy, wm->root_win->xwindow);
-      XSync(wm->xdpy, False);
+      mb_wm_util_sync (wm->xdpy, False);
 #endif
       wm->flags |= MBWindowManagerFlagCursorVisible;
     }
@@ -2462,7 +2746,7 @@ wm_set_cursor_visibility(MBWindowManager *wm, Bool visible)
     {
 #if HAVE_XFIXES
       XFixesHideCursor (wm->xdpy, wm->root_win->xwindow);
-      XSync(wm->xdpy, False);
+      mb_wm_util_sync (wm->xdpy, False);
 #endif
       wm->flags &= ~MBWindowManagerFlagCursorVisible;
     }
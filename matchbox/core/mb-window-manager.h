@@ -63,6 +63,7 @@ typedef enum MBWindowManagerFlag
   MBWindowManagerFlagAlwaysReloadTheme = (1<<1),
   MBWindowManagerFlagLayoutRotated     = (1<<2),
   MBWindowManagerFlagCursorVisible     = (1<<3),
+  MBWindowManagerFlagStartupReport     = (1<<4),
 } MBWindowManagerFlag;
 
 /* signals must be 2^n, as multiple signals can be sent from one call */
@@ -122,6 +123,7 @@ struct MBWindowManager
   MBWMCompMgr                 *comp_mgr;
   int                          damage_event_base;
 #endif
+  int                          shape_event_base; /* 0 if no SHAPE */
 
   MBWindowManagerCursor        cursor;
   Cursor                       cursors[_MBWindowManagerCursorLast];
@@ -137,6 +139,13 @@ struct MBWindowManager
 
   /* used for assigning focus after stacking a new window */
   Bool                         focus_after_stacking;
+
+  /* whether the clients' visible regions reflect the current stack */
+  Bool                         occlusion_valid;
+
+  /* last value we wrote to each (window, property), see mb-wm-props.c */
+  GHashTable                  *prop_cache;
+  unsigned long                props_suppressed;
 };
 
 /**
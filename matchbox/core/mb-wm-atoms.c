@@ -115,15 +115,22 @@ mb_wm_atoms_init(MBWindowManager *wm)
     "_NET_WM_WINDOW_TYPE_DND",
 
     "_HILDON_LIVE_DESKTOP_BACKGROUND",
+
+    "_MB_WM_STATS",
   };
+  gint64 start;
 
   /* FIXME: Error Traps */
   
   MBWM_ASSERT (MBWM_ATOM_COUNT == sizeof (atom_names) / sizeof (char*));
 
+  start = g_get_monotonic_time ();
+
   XInternAtoms (wm->xdpy,
 		atom_names,
 		MBWM_ATOM_COUNT,
                 False,
 		wm->atoms);
+
+  mb_wm_stats_round_trip (start);
 }
@@ -122,7 +122,7 @@ mb_wm_client_base_destroy (MBWMObject *this)
     {
       MB_WM_CLIENT(li->data)->transient_for = NULL;
       next = li->next;
-      free (li);
+      mb_wm_util_list_free_item (li);
     }
 }
 
@@ -153,6 +153,18 @@ mb_wm_client_base_class_type ()
   return type;
 }
 
+/* Reparents the client window, keeping track of where it ends up */
+static void
+reparent_client_xwin (MBWindowManagerClient *client, Window parent,
+		      int x, int y)
+{
+  XReparentWindow (client->wmref->xdpy, MB_WM_CLIENT_XWIN(client),
+		   parent, x, y);
+
+  client->window->x_geometry.x = x;
+  client->window->x_geometry.y = y;
+}
+
 static void
 mb_wm_client_base_realize (MBWindowManagerClient *client)
 {
@@ -227,6 +239,8 @@ mb_wm_client_base_realize (MBWindowManagerClient *client)
 				&attr);
 	      mb_wm_rename_window (wm, client->xwin_frame, "nonalphaframe");
 	    }
+
+	  client->frame_x_geometry = client->frame_geometry;
         }
 
       g_debug("frame for window 0x%lx is 0x%lx",
@@ -241,13 +255,12 @@ mb_wm_client_base_realize (MBWindowManagerClient *client)
        * together with any decoration creation. Layout
        * manager will call this
        */
-      XReparentWindow(wm->xdpy,
-	              MB_WM_CLIENT_XWIN(client),
-                      (client->window->ewmh_state
-                       & MBWMClientWindowEWMHStateFullscreen)
-                        ?  client->wmref->root_win->xwindow
-                        : client->xwin_frame,
-                      0, 0);
+      reparent_client_xwin (client,
+                            (client->window->ewmh_state
+                             & MBWMClientWindowEWMHStateFullscreen)
+                              ?  client->wmref->root_win->xwindow
+                              : client->xwin_frame,
+                            0, 0);
     }
   else
     {
@@ -255,9 +268,7 @@ mb_wm_client_base_realize (MBWindowManagerClient *client)
        * This is an undecorated client; we must reparent the window to our
        * root, otherwise we restacking of pre-existing windows might fail.
        */
-      XReparentWindow(client->wmref->xdpy,
-                      MB_WM_CLIENT_XWIN(client),
-                      client->wmref->root_win->xwindow, 0, 0);
+      reparent_client_xwin (client, client->wmref->root_win->xwindow, 0, 0);
     }
 
   /*
@@ -381,7 +392,6 @@ mb_wm_client_base_set_state_props (MBWindowManagerClient *c)
   unsigned long     flags = c->window->ewmh_state;
   Window            xwin  = c->window->xwindow;
   MBWindowManager  *wm    = c->wmref;
-  Display          *xdpy  = wm->xdpy;
   long            card32[2];
   Atom              ewmh_state [MBWMClientWindowEWHMStatesCount];
   int               ewmh_i = 0;
@@ -424,16 +434,15 @@ mb_wm_client_base_set_state_props (MBWindowManagerClient *c)
     ewmh_state[ewmh_i++] = wm->atoms[MBWM_ATOM_NET_WM_STATE_HIDDEN];
 
 
-  XChangeProperty(xdpy, xwin, wm->atoms[MBWM_ATOM_WM_STATE],
-		  wm->atoms[MBWM_ATOM_WM_STATE], 32, PropModeReplace,
-		  (void *)&card32[0], 2);
+  mb_wm_property_change (wm, xwin, wm->atoms[MBWM_ATOM_WM_STATE],
+			 wm->atoms[MBWM_ATOM_WM_STATE], 32,
+			 &card32[0], 2);
 
   if (ewmh_i)
-    XChangeProperty (xdpy, xwin, wm->atoms[MBWM_ATOM_NET_WM_STATE],
-		     XA_ATOM, 32, PropModeReplace,
-		     (void*) &ewmh_state[0], ewmh_i);
+    mb_wm_property_change (wm, xwin, wm->atoms[MBWM_ATOM_NET_WM_STATE],
+			   XA_ATOM, 32, &ewmh_state[0], ewmh_i);
   else
-    XDeleteProperty (xdpy, xwin, wm->atoms[MBWM_ATOM_NET_WM_STATE]);
+    mb_wm_property_delete (wm, xwin, wm->atoms[MBWM_ATOM_NET_WM_STATE]);
 }
 
 static void
@@ -458,7 +467,8 @@ send_synthetic_configure_notify (MBWindowManagerClient *client)
 }
 
 static void
-move_resize_client_xwin (MBWindowManagerClient *client, int x, int y, int w, int h)
+move_resize_client_xwin (MBWindowManagerClient *client, int x, int y, int w, int h,
+			 Bool frame_moved)
 {
   MBWindowManager *wm = client->wmref;
 
@@ -471,18 +481,18 @@ move_resize_client_xwin (MBWindowManagerClient *client, int x, int y, int w, int
    * ConfigureNotify wouldn't be sent in direct response to the
    * request which I think is the real point)
    *
-   * NB: It's assumed that no cleverness is going elsewhere
-   * to optimise out calls to this function when the move/resize
-   * is obviously not needed (e.g. when just moving the frame
-   * of a client)
+   * We do not send the server a move/resize that would not change
+   * anything, so the client gets no real ConfigureNotify then; if its
+   * frame was moved it has to hear about its new position from us.
    */
-  if (mb_wm_client_needs_configure_request_ack (client)
-      && x == client->window->x_geometry.x
+  if (x == client->window->x_geometry.x
       && y == client->window->x_geometry.y
       && w == client->window->x_geometry.width
       && h == client->window->x_geometry.height)
     {
-      send_synthetic_configure_notify (client);
+      /* Nothing changed, so the texture need not be refetched either */
+      if (mb_wm_client_needs_configure_request_ack (client) || frame_moved)
+	send_synthetic_configure_notify (client);
     }
   else
     {
@@ -510,8 +520,13 @@ is_window_mapped (
     Window    window)
 {
   XWindowAttributes attr;
+  gint64            start = g_get_monotonic_time ();
+  Status            status;
+
+  status = XGetWindowAttributes (display, window, &attr);
+  mb_wm_stats_round_trip (start);
 
-  if (!XGetWindowAttributes (display, window, &attr))
+  if (!status)
     return False;
 
   return attr.map_state == IsViewable;
@@ -564,8 +579,7 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 		  client->skip_unmaps++;
                   MB_WM_DBG_SKIP_UNMAPS (client);
 		  XMapWindow(wm->xdpy, client->xwin_frame);
-		  XReparentWindow(wm->xdpy, MB_WM_CLIENT_XWIN(client),
-				  client->xwin_frame, 0, 0);
+		  reparent_client_xwin (client, client->xwin_frame, 0, 0);
 		  XMapSubwindows(wm->xdpy, client->xwin_frame);
 
 		  /* The frame is very likely the correct dimensions (since the
@@ -583,8 +597,7 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
                       MB_WM_DBG_SKIP_UNMAPS (client);
                     }
 
-		  XReparentWindow(wm->xdpy, MB_WM_CLIENT_XWIN(client),
-				  wm->root_win->xwindow, 0, 0);
+		  reparent_client_xwin (client, wm->root_win->xwindow, 0, 0);
 		  XUnmapWindow(wm->xdpy, client->xwin_frame);
 		  XMapWindow(wm->xdpy, MB_WM_CLIENT_XWIN(client));
 
@@ -594,10 +607,9 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	    { /* Undecorated windows are always parented at the root. */
 	      client->skip_unmaps++;
               MB_WM_DBG_SKIP_UNMAPS (client);
-	      XReparentWindow(wm->xdpy, MB_WM_CLIENT_XWIN(client),
-			      wm->root_win->xwindow,
-			      client->window->geometry.x,
-			      client->window->geometry.y);
+	      reparent_client_xwin (client, wm->root_win->xwindow,
+				    client->window->geometry.x,
+				    client->window->geometry.y);
 	    }
           /* What if the window has changed its undecoratedness hint?
            * We have never supported it, it seems. */
@@ -636,7 +648,7 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	  w = client->window->geometry.width;
 	  h = client->window->geometry.height;
 
-	  move_resize_client_xwin (client, x, y, w, h);
+	  move_resize_client_xwin (client, x, y, w, h, False);
 
 	  wgeom[0] = 0;
 	  wgeom[1] = 0;
@@ -645,14 +657,27 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	}
       else
 	{
-          MB_WM_DBG_MOVE_RESIZE ("frame", client->xwin_frame,
-                                 &client->frame_geometry);
-	  XMoveResizeWindow(wm->xdpy,
-			    client->xwin_frame,
-			    client->frame_geometry.x,
-			    client->frame_geometry.y,
-			    client->frame_geometry.width,
-			    client->frame_geometry.height);
+	  Bool frame_moved;
+
+	  frame_moved =
+	    client->frame_geometry.x != client->frame_x_geometry.x ||
+	    client->frame_geometry.y != client->frame_x_geometry.y;
+
+	  if (frame_moved ||
+	      client->frame_geometry.width != client->frame_x_geometry.width ||
+	      client->frame_geometry.height != client->frame_x_geometry.height)
+	    {
+	      MB_WM_DBG_MOVE_RESIZE ("frame", client->xwin_frame,
+				     &client->frame_geometry);
+	      XMoveResizeWindow(wm->xdpy,
+				client->xwin_frame,
+				client->frame_geometry.x,
+				client->frame_geometry.y,
+				client->frame_geometry.width,
+				client->frame_geometry.height);
+
+	      client->frame_x_geometry = client->frame_geometry;
+	    }
 
 	  /* FIXME: Call XConfigureWindow(w->dpy, e->window,
 	   *        value_mask,&xwc); here instead as can set border
@@ -663,7 +688,7 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	  w = client->window->geometry.width;
 	  h = client->window->geometry.height;
 
-	  move_resize_client_xwin (client, x, y, w, h);
+	  move_resize_client_xwin (client, x, y, w, h, frame_moved);
 
 	  wgeom[0] = x;
 	  wgeom[1] = client->frame_geometry.width - w - x;
@@ -671,11 +696,9 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	  wgeom[3] = client->frame_geometry.height - h - y;
 	}
 
-      XChangeProperty(wm->xdpy,
-		      MB_WM_CLIENT_XWIN(client),
-		      wm->atoms[MBWM_ATOM_NET_FRAME_EXTENTS],
-		      XA_CARDINAL, 32, PropModeReplace,
-		      (unsigned char *)&wgeom[0], 4);
+      mb_wm_property_change (wm, MB_WM_CLIENT_XWIN(client),
+			     wm->atoms[MBWM_ATOM_NET_FRAME_EXTENTS],
+			     XA_CARDINAL, 32, &wgeom[0], 4);
 
       mb_wm_util_async_untrap_x_errors();
       /* FIXME: need flags to handle other stuff like configure events etc */
@@ -757,9 +780,24 @@ mb_wm_client_base_display_sync (MBWindowManagerClient *client)
 	  rects[0].width  = client->window->geometry.width;
 	  rects[0].height = client->window->geometry.height;
 
-	  XShapeCombineRectangles (wm->xdpy, client->xwin_frame,
-				   ShapeBounding,
-				   0, 0, rects, 1, ShapeSet, 0 );
+	  /*
+	   * The decors only ever add themselves to the shape, so while
+	   * neither the frame size nor the window within it changes the
+	   * shape we already set is still good.
+	   */
+	  if (memcmp (&rects[0], &client->frame_shape, sizeof (XRectangle)) ||
+	      client->frame_geometry.width !=
+	      client->frame_shape_geometry.width ||
+	      client->frame_geometry.height !=
+	      client->frame_shape_geometry.height)
+	    {
+	      XShapeCombineRectangles (wm->xdpy, client->xwin_frame,
+				       ShapeBounding,
+				       0, 0, rects, 1, ShapeSet, 0 );
+
+	      client->frame_shape          = rects[0];
+	      client->frame_shape_geometry = client->frame_geometry;
+	    }
 	}
 #endif
 
@@ -864,10 +902,9 @@ mb_wm_client_base_focus (MBWindowManagerClient *client)
 
   success = mb_wm_client_set_focus (client);
 
-  XChangeProperty(wm->xdpy, wm->root_win->xwindow,
-		  wm->atoms[MBWM_ATOM_NET_ACTIVE_WINDOW],
-		  XA_WINDOW, 32, PropModeReplace,
-		  (unsigned char *)&xwin, 1);
+  mb_wm_property_change (wm, wm->root_win->xwindow,
+			 wm->atoms[MBWM_ATOM_NET_ACTIVE_WINDOW],
+			 XA_WINDOW, 32, &xwin, 1);
 
   if (!success)
     return False;
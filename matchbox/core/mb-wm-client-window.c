@@ -20,6 +20,10 @@
 
 #include "mb-wm.h"
 
+#ifdef HAVE_XEXT
+#include <X11/extensions/shape.h>
+#endif
+
 /* Via Xatomtype.h */
 #define NumPropWMHintsElements 9 /* number of elements in this structure */
 
@@ -62,6 +66,11 @@ enum {
 #define MWM_DECOR_MINIMIZE            (1L << 5)
 #define MWM_DECOR_MAXIMIZE            (1L << 6)
 
+static Bool
+mb_wm_client_window_process_properties (MBWMClientWindow *win,
+					unsigned long     props_req,
+					MBWMCookie       *cookies);
+
 static void
 mb_wm_client_window_class_init (MBWMObjectClass *klass)
 {
@@ -94,6 +103,11 @@ mb_wm_client_window_destroy (MBWMObject *this)
       l = l->next;
     }
 
+  mb_wm_client_window_invalidate_shape (win);
+
+  if (win->wm)
+    mb_wm_property_forget_window (win->wm, win->xwindow);
+
   memset (win, 0, sizeof (*win));
 }
 
@@ -104,6 +118,7 @@ mb_wm_client_window_init (MBWMObject *this, va_list vap)
   MBWMObjectProp    prop;
   MBWindowManager  *wm = NULL;
   Window            xwin = None;
+  MBWMCookie       *cookies = NULL;
 
   prop = va_arg(vap, MBWMObjectProp);
   while (prop)
@@ -116,6 +131,9 @@ mb_wm_client_window_init (MBWMObject *this, va_list vap)
 	case MBWMObjectPropXwindow:
 	  xwin = va_arg(vap, Window);
 	  break;
+	case MBWMObjectPropClientWindowCookies:
+	  cookies = va_arg(vap, MBWMCookie *);
+	  break;
 	default:
 	  MBWMO_PROP_EAT (vap, prop);
 	}
@@ -133,8 +151,22 @@ mb_wm_client_window_init (MBWMObject *this, va_list vap)
   win->wm = wm;
   win->portrait_supported = win->portrait_requested = -1;
 
+#ifdef HAVE_XEXT
+  /* So that we know when our copy of the shape goes stale */
+  if (wm->shape_event_base)
+    {
+      mb_wm_util_async_trap_x_errors (wm->xdpy);
+      XShapeSelectInput (wm->xdpy, xwin, ShapeNotifyMask);
+      mb_wm_util_async_untrap_x_errors ();
+    }
+#endif
+
   /* TODO: handle properties after discovering them. E.g. fullscreen.
    * See NB#97342 */
+  if (cookies)
+    return mb_wm_client_window_process_properties (win, MBWM_WINDOW_PROP_ALL,
+						   cookies);
+
   return mb_wm_client_window_sync_properties (win, MBWM_WINDOW_PROP_ALL);
 }
 
@@ -171,27 +203,36 @@ mb_wm_client_window_new (MBWindowManager *wm, Window xwin)
   return win;
 }
 
-Bool
-mb_wm_client_window_sync_properties ( MBWMClientWindow *win,
-				     unsigned long     props_req)
+/*
+ * Like mb_wm_client_window_new(), but takes the properties from the
+ * replies to an earlier mb_wm_client_window_prefetch() instead of fetching
+ * them now.  The cookies are consumed either way; the caller still has to
+ * free the array.
+ */
+MBWMClientWindow*
+mb_wm_client_window_new_prefetched (MBWindowManager *wm, Window xwin,
+				    MBWMCookie *cookies)
 {
-  MBWMCookie       cookies[N_COOKIES] = {0};
-  MBWindowManager *wm = win->wm;
-  Atom             actual_type_return;
-  unsigned char   *result_atom = NULL;
-  int              actual_format_return;
-  unsigned long    nitems_return;
-  unsigned long    bytes_after_return;
-  unsigned int     foo;
-  int              x_error_code = Success;
-  Window           xwin;
-  int              changes = 0;
-  Bool             abort_exit = False;
-
-  MBWMClientWindowAttributes *xwin_attr = NULL;
+  MBWMClientWindow *win;
 
-  xwin = win->xwindow;
+  win = MB_WM_CLIENT_WINDOW (mb_wm_object_new (MB_WM_TYPE_CLIENT_WINDOW,
+					       MBWMObjectPropWm,      wm,
+					       MBWMObjectPropXwindow, xwin,
+				       MBWMObjectPropClientWindowCookies, cookies,
+					       NULL));
+  return win;
+}
 
+/*
+ * Sends the requests for the @props_req properties of @xwin; the cookies
+ * are stored in @cookies, which must be N_COOKIES long.
+ */
+static void
+mb_wm_client_window_request_properties (MBWindowManager *wm,
+					Window           xwin,
+					unsigned long    props_req,
+					MBWMCookie      *cookies)
+{
   if (props_req & MBWM_WINDOW_PROP_WIN_TYPE)
     cookies[COOKIE_WIN_TYPE]
       = mb_wm_property_atom_req(wm, xwin,
@@ -348,14 +389,32 @@ mb_wm_client_window_sync_properties ( MBWMClientWindow *win,
 	  	wm->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_REQUEST]);
     }
 
-  {
-    /* FIXME: toggling 'offline' mode in power menu can cause X error here */
-    /* bundle all pending requests to server and wait for replys.
-     * Errors will be caught by the new error handler. Note that removing this
-     * absolutely kills hildon-desktop. It appears that the property specifying
-     * window type doesn't get read and everything gets mapped as an app.  */
-    XSync(wm->xdpy, False);
-  }
+}
+
+/*
+ * Processes the replies to mb_wm_client_window_request_properties(); they
+ * must all have arrived by now.
+ */
+static Bool
+mb_wm_client_window_process_properties (MBWMClientWindow *win,
+					unsigned long     props_req,
+					MBWMCookie       *cookies)
+{
+  MBWindowManager *wm = win->wm;
+  Atom             actual_type_return;
+  unsigned char   *result_atom = NULL;
+  int              actual_format_return;
+  unsigned long    nitems_return;
+  unsigned long    bytes_after_return;
+  unsigned int     foo;
+  int              x_error_code = Success;
+  Window           xwin;
+  int              changes = 0;
+  Bool             abort_exit = False;
+
+  MBWMClientWindowAttributes *xwin_attr = NULL;
+
+  xwin = win->xwindow;
 
   if (props_req & MBWM_WINDOW_PROP_TRANSIENCY)
     {
@@ -1373,6 +1432,53 @@ badwindow_error:
     return False;
 }
 
+Bool
+mb_wm_client_window_sync_properties ( MBWMClientWindow *win,
+				     unsigned long     props_req)
+{
+  MBWMCookie       cookies[N_COOKIES] = {0};
+  MBWindowManager *wm = win->wm;
+  Bool             ret;
+
+  MBWM_SPAN_BEGIN ("sync-properties", NULL, win->xwindow);
+
+  mb_wm_client_window_request_properties (wm, win->xwindow,
+					  props_req, cookies);
+
+  {
+    /* FIXME: toggling 'offline' mode in power menu can cause X error here */
+    /* bundle all pending requests to server and wait for replys.
+     * Errors will be caught by the new error handler. Note that removing this
+     * absolutely kills hildon-desktop. It appears that the property specifying
+     * window type doesn't get read and everything gets mapped as an app.  */
+    mb_wm_util_sync (wm->xdpy, False);
+  }
+
+  ret = mb_wm_client_window_process_properties (win, props_req, cookies);
+
+  MBWM_SPAN_END ("sync-properties");
+
+  return ret;
+}
+
+/*
+ * Sends the requests for all the properties of @xwin without waiting for
+ * the replies, so that several windows can be set up with one round-trip;
+ * the result is to be passed to mb_wm_client_window_new_prefetched() once
+ * the replies are in (after an XSync).
+ */
+MBWMCookie*
+mb_wm_client_window_prefetch (MBWindowManager *wm, Window xwin)
+{
+  MBWMCookie *cookies;
+
+  cookies = mb_wm_util_malloc0 (N_COOKIES * sizeof (MBWMCookie));
+  mb_wm_client_window_request_properties (wm, xwin,
+					  MBWM_WINDOW_PROP_ALL, cookies);
+
+  return cookies;
+}
+
 Bool
 mb_wm_client_window_is_state_set (MBWMClientWindow *win,
 				  MBWMClientWindowEWMHState state)
@@ -1380,3 +1486,76 @@ mb_wm_client_window_is_state_set (MBWMClientWindow *win,
   return (win->ewmh_state & state) ? True : False;
 }
 
+/*
+ * Returns the bounding shape of the window as a list of rectangles, or
+ * NULL if it cannot be had.  The rectangles belong to the window and are
+ * only fetched from the server again after the shape has changed.
+ */
+XRectangle *
+mb_wm_client_window_get_shape (MBWMClientWindow *win, int *n_rects)
+{
+#ifdef HAVE_XEXT
+  MBWindowManager *wm = win->wm;
+  int              order;
+
+  if (!win->shape_valid)
+    {
+      gint64 start;
+
+      mb_wm_client_window_invalidate_shape (win);
+
+      mb_wm_util_async_trap_x_errors (wm->xdpy);
+      start = g_get_monotonic_time ();
+      win->shape_rects = XShapeGetRectangles (wm->xdpy, win->xwindow,
+					      ShapeBounding,
+					      &win->n_shape_rects, &order);
+      mb_wm_stats_round_trip (start);
+      mb_wm_util_async_untrap_x_errors ();
+
+      /* Without ShapeNotify we cannot tell when to fetch it again */
+      win->shape_valid = wm->shape_event_base != 0;
+    }
+
+  *n_rects = win->n_shape_rects;
+  return win->shape_rects;
+#else
+  *n_rects = 0;
+  return NULL;
+#endif
+}
+
+/*
+ * Returns True if the bounding shape of the window leaves out any part of
+ * it; a shape that cannot be had counts as shaped.
+ */
+Bool
+mb_wm_client_window_is_shaped (MBWMClientWindow *win)
+{
+#ifdef HAVE_XEXT
+  XRectangle *rects;
+  int         n_rects;
+
+  if (!win->wm->shape_event_base)
+    return False;
+
+  rects = mb_wm_client_window_get_shape (win, &n_rects);
+
+  return !rects || n_rects != 1 ||
+    rects[0].x > 0 || rects[0].y > 0 ||
+    rects[0].x + rects[0].width < (int) win->geometry.width ||
+    rects[0].y + rects[0].height < (int) win->geometry.height;
+#else
+  return False;
+#endif
+}
+
+void
+mb_wm_client_window_invalidate_shape (MBWMClientWindow *win)
+{
+  if (win->shape_rects)
+    XFree (win->shape_rects);
+
+  win->shape_rects   = NULL;
+  win->n_shape_rects = 0;
+  win->shape_valid   = False;
+}
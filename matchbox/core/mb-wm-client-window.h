@@ -173,6 +173,11 @@ struct MBWMClientWindow
    * in which case it is inherited from transient_for */
   int                            portrait_supported, portrait_requested;
   int                            live_background;
+
+  /* bounding shape, kept until a ShapeNotify tells us it changed */
+  XRectangle                    *shape_rects;
+  int                            n_shape_rects;
+  Bool                           shape_valid;
 };
 
 struct MBWMClientWindowClass
@@ -186,6 +191,13 @@ mb_wm_client_window_class_type ();
 MBWMClientWindow*
 mb_wm_client_window_new (MBWindowManager *wm, Window xwin);
 
+MBWMCookie*
+mb_wm_client_window_prefetch (MBWindowManager *wm, Window xwin);
+
+MBWMClientWindow*
+mb_wm_client_window_new_prefetched (MBWindowManager *wm, Window xwin,
+				    MBWMCookie *cookies);
+
 Bool
 mb_wm_client_window_sync_properties (MBWMClientWindow *win,
 				     unsigned long     props_req);
@@ -194,4 +206,13 @@ Bool
 mb_wm_client_window_is_state_set (MBWMClientWindow *win,
 				  MBWMClientWindowEWMHState state);
 
+XRectangle *
+mb_wm_client_window_get_shape (MBWMClientWindow *win, int *n_rects);
+
+Bool
+mb_wm_client_window_is_shaped (MBWMClientWindow *win);
+
+void
+mb_wm_client_window_invalidate_shape (MBWMClientWindow *win);
+
 #endif
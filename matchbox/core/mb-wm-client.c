@@ -43,6 +43,8 @@ struct MBWindowManagerClientPriv
   Bool          hiding_from_desktop;
   Bool          geometry_requested;
   MBWMSyncType  sync_state;
+  Bool          occluded;
+  Region        visible_region;
 };
 
 static void
@@ -83,7 +85,12 @@ mb_wm_client_destroy (MBWMObject *obj)
     mb_wm_client_remove_transient (client->transient_for, client);
 
   if (client->priv)
-    free (client->priv);
+    {
+      if (client->priv->visible_region)
+	XDestroyRegion (client->priv->visible_region);
+
+      free (client->priv);
+    }
 
   memset (client, 0, sizeof (*client));
 }
@@ -303,6 +310,10 @@ mb_wm_client_on_property_change (MBWMClientWindow        *window,
       mb_wm_client_stacking_mark_dirty (client);
     }
 
+  /* Whether the client is opaque may have changed */
+  if (property & MBWM_WINDOW_PROP_CM_TRANSLUCENCY)
+    mb_wm_display_sync_queue (client->wmref, MBWMSyncVisibility);
+
 #if ENABLE_COMPOSITE
   if ((property & MBWM_WINDOW_PROP_CM_TRANSLUCENCY) &&
       client->cm_client && mb_wm_comp_mgr_enabled (client->wmref->comp_mgr))
@@ -1048,6 +1059,10 @@ mb_wm_client_theme_change (MBWindowManagerClient *client)
 
   klass = MB_WM_CLIENT_CLASS (MB_WM_OBJECT_GET_CLASS (client));
 
+  /* The decors of the new theme may be shaped differently */
+  client->frame_shape.width = 0;
+  mb_wm_display_sync_queue (client->wmref, MBWMSyncVisibility);
+
   if (klass->theme_change)
     klass->theme_change (client);
 }
@@ -1213,7 +1228,7 @@ mb_wm_client_reset_hiding_from_desktop (MBWindowManagerClient * client)
  * mapped, not hiding from the desktop, and at least
  * partially onscreen.
  * Does not check whether it's obscured by a higher
- * window (should it?)
+ * window; see mb_wm_client_is_occluded() for that.
  */
 Bool
 mb_wm_client_is_visible (MBWindowManagerClient * client)
@@ -1257,6 +1272,60 @@ mb_wm_client_covers_screen (MBWindowManagerClient * client)
     bottom >= bottom_of_screen;
 }
 
+/**
+ * Returns true if nothing below the client shows through it: it has
+ * no alpha channel, no translucency set, and neither its frame nor its
+ * window is shaped.
+ */
+Bool
+mb_wm_client_is_opaque (MBWindowManagerClient * client)
+{
+  MBWindowManager *wm = client->wmref;
+
+  return
+    !client->is_argb32 &&
+    client->window->translucency == -1 &&
+    !(wm->theme && mb_wm_theme_is_client_shaped (wm->theme, client)) &&
+    !mb_wm_client_window_is_shaped (client->window);
+}
+
+/**
+ * Returns true if the last occlusion pass found no part of the client
+ * on screen and nothing has changed the stack, geometry or visibility
+ * since; when in doubt the client is not occluded.
+ */
+Bool
+mb_wm_client_is_occluded (MBWindowManagerClient * client)
+{
+  return client->wmref->occlusion_valid && client->priv->occluded;
+}
+
+/**
+ * Returns the part of the screen where the client can be seen, as worked
+ * out by mb_wm_stack_update_occlusion(), or NULL if that is not known.
+ * The region belongs to the client and is only valid until the next sync.
+ */
+Region
+mb_wm_client_get_visible_region (MBWindowManagerClient * client)
+{
+  if (!client->wmref->occlusion_valid)
+    return NULL;
+
+  return client->priv->visible_region;
+}
+
+/* Takes ownership of @region; for use by the occlusion pass. */
+void
+mb_wm_client_set_visible_region (MBWindowManagerClient * client,
+				 Region                  region)
+{
+  if (client->priv->visible_region)
+    XDestroyRegion (client->priv->visible_region);
+
+  client->priv->visible_region = region;
+  client->priv->occluded = XEmptyRegion (region);
+}
+
 /* Returns whether we're confident the newly mapped @client wants
  * the screen to be rotated. */
 Bool
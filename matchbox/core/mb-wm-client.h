@@ -173,6 +173,7 @@ struct MBWindowManagerClient
   MBWindowManagerClient       *stacked_above, *stacked_below;
 
   MBGeometry frame_geometry;  /* FIXME: in ->priv ? */
+  MBGeometry frame_x_geometry; /* as last sent to the server */
   /**
    * List of MBWMDecor objects.
    * \bug Why is this not an array?  When do we ever not have four?
@@ -224,6 +225,10 @@ struct MBWindowManagerClient
 
   int                          desktop;
 
+  /* base frame shape last set, and the frame size it was set for */
+  XRectangle                   frame_shape;
+  MBGeometry                   frame_shape_geometry;
+
 #if ENABLE_COMPOSITE
   MBWMCompMgrClient           *cm_client;
 #endif
@@ -471,6 +476,19 @@ mb_wm_client_is_visible (MBWindowManagerClient * client);
 Bool
 mb_wm_client_covers_screen (MBWindowManagerClient * client);
 
+Bool
+mb_wm_client_is_opaque (MBWindowManagerClient * client);
+
+Bool
+mb_wm_client_is_occluded (MBWindowManagerClient * client);
+
+Region
+mb_wm_client_get_visible_region (MBWindowManagerClient * client);
+
+void
+mb_wm_client_set_visible_region (MBWindowManagerClient * client,
+				 Region                  region);
+
 Bool
 mb_wm_client_wants_portrait (MBWindowManagerClient * client);
 void
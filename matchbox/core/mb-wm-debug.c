@@ -37,6 +37,7 @@ static const struct { const char *key; MBWMDebugFlag flag; } debug_keys[] = {
   { "xas",       MBWM_DEBUG_XAS },
   { "compositor",MBWM_DEBUG_COMPOSITOR },
   { "damage",    MBWM_DEBUG_DAMAGE },
+  { "layout",    MBWM_DEBUG_LAYOUT },
 };
 #endif
 
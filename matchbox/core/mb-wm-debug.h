@@ -56,6 +56,7 @@ typedef enum {
   MBWM_DEBUG_XAS             = 1 << 8,
   MBWM_DEBUG_COMPOSITOR      = 1 << 9,
   MBWM_DEBUG_DAMAGE          = 1 << 10,
+  MBWM_DEBUG_LAYOUT          = 1 << 11,
 } MBWMDebugFlag;
 
 extern int mbwm_debug_flags;
@@ -200,26 +200,189 @@ mb_wm_decor_resize (MBWMDecor *decor)
 static Bool
 mb_wm_decor_reparent (MBWMDecor *decor);
 
+static void
+mb_wm_decor_button_stock_button_action (MBWMDecorButton *button);
+
+static void
+mb_wm_decor_button_set_pressed (MBWMDecorButton *button, Bool pressed)
+{
+  MBWMDecorButtonState state;
+
+  state = pressed ? MBWMDecorButtonStatePressed : MBWMDecorButtonStateInactive;
+
+  if (button->state != state)
+    {
+      button->state = state;
+      mb_wm_theme_paint_button (button->decor->parent_client->wmref->theme,
+				button);
+    }
+}
+
 static Bool
-mb_wm_decor_release_handler (XButtonEvent    *xev,
-			     void            *userdata)
+mb_wm_decor_button_contains (MBWMDecorButton *button, int x, int y)
 {
-  MBWMDecor       *decor  = userdata;
-  MBWindowManager *wm;
+  return (x >= button->geom.x && x <= button->geom.x + button->geom.width &&
+	  y >= button->geom.y && y <= button->geom.y + button->geom.height);
+}
+
+static Bool
+mb_wm_decor_grab_motion_handler (XMotionEvent    *xev,
+				 void            *userdata);
+
+static Bool
+mb_wm_decor_grab_release_handler (XButtonEvent    *xev,
+				  void            *userdata);
+
+/*
+ * Grabs the pointer for a drag or a held button; what follows is handled
+ * as the events come through the main context.
+ */
+static Bool
+mb_wm_decor_grab_begin (MBWMDecor       *decor,
+			MBWMDecorGrab    grab,
+			MBWMDecorButton *button)
+{
+  MBWindowManager *wm = decor->parent_client->wmref;
+  int              status;
+  gint64           start;
+
+  mb_wm_util_async_trap_x_errors(wm->xdpy);
+  start = g_get_monotonic_time ();
+  status = XGrabPointer(wm->xdpy, decor->xwin, False,
+			ButtonPressMask|ButtonReleaseMask|PointerMotionMask,
+			GrabModeAsync,
+			GrabModeAsync,
+			None, None, CurrentTime);
+  mb_wm_stats_round_trip (start);
+  mb_wm_util_async_untrap_x_errors();
 
-  if (decor == NULL || decor->parent_client == NULL
-      || decor->parent_client->wmref == NULL)
+  if (status != GrabSuccess)
     return False;
 
+  decor->grab        = grab;
+  decor->grab_button = button;
+
+  decor->motion_cb_id = mb_wm_main_context_x_event_handler_add (
+				 wm->main_ctx,
+				 decor->xwin,
+				 MotionNotify,
+				 (MBWMXEventFunc)mb_wm_decor_grab_motion_handler,
+				 decor);
+
+  decor->release_cb_id = mb_wm_main_context_x_event_handler_add (
+				 wm->main_ctx,
+				 decor->xwin,
+				 ButtonRelease,
+				 (MBWMXEventFunc)mb_wm_decor_grab_release_handler,
+				 decor);
+
+  return True;
+}
+
+/* Lets go of the pointer, be it because of the release or our demise */
+static void
+mb_wm_decor_grab_end (MBWMDecor *decor)
+{
+  MBWindowManager *wm;
+
+  if (decor->grab == MBWMDecorGrabNone)
+    return;
+
   wm = decor->parent_client->wmref;
 
+  mb_wm_main_context_x_event_handler_remove (wm->main_ctx, MotionNotify,
+					     decor->motion_cb_id);
   mb_wm_main_context_x_event_handler_remove (wm->main_ctx, ButtonRelease,
 					     decor->release_cb_id);
 
+  decor->motion_cb_id  = 0;
   decor->release_cb_id = 0;
 
   XUngrabPointer (wm->xdpy, CurrentTime);
 
+  decor->grab        = MBWMDecorGrabNone;
+  decor->grab_button = NULL;
+}
+
+static Bool
+mb_wm_decor_grab_motion_handler (XMotionEvent    *xev,
+				 void            *userdata)
+{
+  MBWMDecor       *decor = userdata;
+  MBWindowManager *wm;
+  XEvent           ev;
+
+  if (decor->grab == MBWMDecorGrabNone || !decor->parent_client)
+    return True;
+
+  wm = decor->parent_client->wmref;
+
+  /*
+   * Only the latest position matters; the move itself is done by the next
+   * sync, so there is at most one of those per main loop iteration.
+   */
+  while (XCheckTypedWindowEvent (wm->xdpy, decor->xwin, MotionNotify, &ev))
+    xev = &ev.xmotion;
+
+  if (decor->grab == MBWMDecorGrabDrag)
+    {
+      MBGeometry geom;
+
+      mb_wm_client_get_coverage (decor->parent_client, &geom);
+
+      geom.x = decor->grab_x + xev->x_root - decor->grab_root_x;
+      geom.y = decor->grab_y + xev->y_root - decor->grab_root_y;
+
+      mb_wm_client_request_geometry (decor->parent_client,
+				     &geom,
+				     MBWMClientReqGeomIsViaUserAction);
+    }
+  else if (decor->grab_button->realized)
+    {
+      mb_wm_decor_button_set_pressed (decor->grab_button,
+			mb_wm_decor_button_contains (decor->grab_button,
+						     xev->x, xev->y));
+    }
+
+  return False;
+}
+
+static Bool
+mb_wm_decor_grab_release_handler (XButtonEvent    *xev,
+				  void            *userdata)
+{
+  MBWMDecor       *decor  = userdata;
+  MBWMDecorButton *button = decor->grab_button;
+  MBWindowManager *wm;
+  Bool             activate = False;
+
+  if (decor->grab == MBWMDecorGrabNone || !decor->parent_client)
+    return True;
+
+  wm = decor->parent_client->wmref;
+
+  if (decor->grab == MBWMDecorGrabButton && button->realized)
+    {
+      mb_wm_decor_button_set_pressed (button, False);
+      activate = mb_wm_decor_button_contains (button, xev->x, xev->y);
+    }
+
+  mb_wm_decor_grab_end (decor);
+
+  if (activate)
+    {
+      mb_wm_util_sync (wm->xdpy, False); /* necessary */
+
+      mb_wm_object_ref (MB_WM_OBJECT(button));
+
+      if (button->release)
+	button->release(wm, button, button->userdata);
+      else
+	mb_wm_decor_button_stock_button_action (button);
+
+      mb_wm_object_unref (MB_WM_OBJECT(button));
+    }
+
   return False;
 }
 
@@ -227,111 +390,73 @@ static Bool
 mb_wm_decor_press_handler (XButtonEvent    *xev,
 			   void            *userdata)
 {
-  MBWMDecor       *decor  = userdata;
+  MBWMDecor  *decor = userdata;
+  MBGeometry  geom;
+
+  /* A button of ours may have taken the press already */
+  if (xev->window != decor->xwin || decor->grab != MBWMDecorGrabNone)
+    return True;
+
+  mb_wm_client_get_coverage (decor->parent_client, &geom);
+
+  decor->grab_x      = geom.x;
+  decor->grab_y      = geom.y;
+  decor->grab_root_x = xev->x_root;
+  decor->grab_root_y = xev->y_root;
+
+  if (!mb_wm_decor_grab_begin (decor, MBWMDecorGrabDrag, NULL))
+    return True;
+
+  return False;
+}
+
+/*
+ * The decor window is created without waiting for the server to confirm it;
+ * this checks the outcome once it is known (or right away with @wait), and
+ * forgets the window if the creation failed.
+ */
+static Bool
+mb_wm_decor_check_created (MBWMDecor *decor, Bool wait)
+{
   MBWindowManager *wm = decor->parent_client->wmref;
-  Bool             retval = True;
+  int              error;
 
-  if (xev->window == decor->xwin)
-    {
-      XEvent     ev;
-      MBGeometry geom;
-      int        orig_x, orig_y;
-      int        orig_p_x, orig_p_y;
-      int        status;
+  if (!decor->create_trap)
+    return True;
 
-      mb_wm_client_get_coverage (decor->parent_client, &geom);
+  error = mb_wm_util_deferred_x_error (decor->create_trap, wait);
+  if (error < 0)
+    return True; /* don't know yet */
 
-      orig_x   = geom.x;
-      orig_y   = geom.y;
-      orig_p_x = xev->x_root;
-      orig_p_y = xev->y_root;
+  mb_wm_util_deferred_x_error_free (decor->create_trap);
+  decor->create_trap = NULL;
 
-      /*
-       * This is bit tricky: we do a normal pointer drag and pull out any
-       * pointer events out of the queue; when we get a MotionEvent, we
-       * move the client window. However, for the move to propagete on screen
-       * (particularly with a compositor) we need to spin the main loop so
-       * that any queued up ConfigureNotify events get processed;
-       * unfortunately, this invariably results in the ButtonRelease event
-       * landing in the main loop and not in our sub-loop here. So, on the
-       * ButtonPress we install a ButtonRelease callback into the main loop
-       * and use that to release the grab.
-       */
-      mb_wm_util_async_trap_x_errors(wm->xdpy);
-      status = XGrabPointer(wm->xdpy, xev->subwindow, False,
-		       ButtonPressMask|ButtonReleaseMask|
-		       PointerMotionMask|EnterWindowMask|LeaveWindowMask,
-		       GrabModeAsync,
-		       GrabModeAsync,
-		       None, None, CurrentTime);
-      mb_wm_util_async_untrap_x_errors();
-      if (status == GrabSuccess)
-	{
+  if (!error)
+    return True;
 
-	  decor->release_cb_id = mb_wm_main_context_x_event_handler_add (
-				 wm->main_ctx,
-			         decor->xwin,
-			         ButtonRelease,
-			         (MBWMXEventFunc)mb_wm_decor_release_handler,
-			         decor);
+  g_warning ("%s: could not create decor window 0x%lx (error %d)",
+             __FUNCTION__, decor->xwin, error);
 
-	  for (;;)
-	    {
-              if (!decor->release_cb_id)
-                {
-                  /* the handler was called while we spinned the loop */
-		  return False;
-                }
-
-	      XMaskEvent(wm->xdpy,
-			 ButtonPressMask|ButtonReleaseMask|
-			 PointerMotionMask|EnterWindowMask|
-			 LeaveWindowMask,
-			 &ev);
-
-	      switch (ev.type)
-		{
-		case MotionNotify:
-		  {
-		    Bool events_pending;
-		    int  event_count = 5; /*Limit how much we spin the loop*/
-		    XMotionEvent *pev = (XMotionEvent*)&ev;
-		    int diff_x = pev->x_root - orig_p_x;
-		    int diff_y = pev->y_root - orig_p_y;
-
-		    geom.x = orig_x + diff_x;
-		    geom.y = orig_y + diff_y;
-
-		    mb_wm_client_request_geometry (decor->parent_client,
-					   &geom,
-					   MBWMClientReqGeomIsViaUserAction);
-
-		    do
-		      {
-			events_pending =
-			  mb_wm_main_context_spin_loop (wm->main_ctx);
-
-			--event_count;
-		      } while (events_pending && event_count);
-		  }
-		  break;
-		case ButtonRelease:
-		  {
-                    mb_wm_main_context_x_event_handler_remove (
-                                   wm->main_ctx, ButtonRelease,
-			           decor->release_cb_id);
-                    decor->release_cb_id = 0;
-		    XUngrabPointer (wm->xdpy, CurrentTime);
-		    return False;
-		  }
-		default:
-		  ;
-		}
-	    }
-	}
+  if (decor->press_cb_id)
+    {
+      mb_wm_main_context_x_event_handler_remove (wm->main_ctx, ButtonPress,
+                                                 decor->press_cb_id);
+      decor->press_cb_id = 0;
     }
 
-  return retval;
+  /* The buttons listen on the window, which the server may have anyway */
+  mb_wm_util_list_foreach (decor->buttons,
+                           (MBWMListForEachCB)mb_wm_decor_button_unrealize,
+                           NULL);
+
+  mb_wm_util_async_trap_x_errors (wm->xdpy);
+  XDestroyWindow (wm->xdpy, decor->xwin);
+  mb_wm_util_async_untrap_x_errors ();
+
+  decor->xwin = None;
+  decor->create_failed = True;
+
+  return False;
 }
 
 static Bool
@@ -345,6 +470,8 @@ mb_wm_decor_sync_window (MBWMDecor *decor)
 
   wm = decor->parent_client->wmref;
 
+  if (!mb_wm_decor_check_created (decor, False) || decor->create_failed)
+    return False;
 
   if (decor->xwin == None)
     {
@@ -358,8 +485,11 @@ mb_wm_decor_sync_window (MBWMDecor *decor)
       attr.background_pixmap = None;
       attr.event_mask = ButtonPressMask|ButtonReleaseMask|ButtonMotionMask;
 
-      XSync(wm->xdpy, False);
-      mb_wm_util_trap_x_errors();
+      /*
+       * The creation is not waited for; mb_wm_decor_check_created() deals
+       * with any failure later.
+       */
+      decor->create_trap = mb_wm_util_deferred_trap_x_errors (wm->xdpy);
 
       decor->xwin
 	= XCreateWindow(wm->xdpy,
@@ -374,6 +504,10 @@ mb_wm_decor_sync_window (MBWMDecor *decor)
 			CopyFromParent,
 			CWOverrideRedirect/*|CWBackPixel*/|CWEventMask,
 			&attr);
+
+      mb_wm_util_deferred_untrap_x_errors (decor->create_trap);
+
+      decor->x_geom = decor->geom;
       mb_wm_rename_window (wm, decor->xwin, "decor");
 
       MBWM_DBG("g is +%i+%i %ix%i",
@@ -382,9 +516,6 @@ mb_wm_decor_sync_window (MBWMDecor *decor)
 	       decor->geom.width,
 	       decor->geom.height);
 
-      if (mb_wm_util_untrap_x_errors())
-	return False;
-
       mb_wm_decor_resize(decor);
 
       mb_wm_util_list_foreach(decor->buttons,
@@ -414,17 +545,22 @@ mb_wm_decor_sync_window (MBWMDecor *decor)
     }
   else
     {
-      /* Resize */
-      mb_wm_util_async_trap_x_errors_warn(wm->xdpy, "XMoveResizeWindow");
+      /* Resize, unless the server already has it right */
+      if (memcmp (&decor->geom, &decor->x_geom, sizeof (MBGeometry)))
+	{
+	  mb_wm_util_async_trap_x_errors_warn(wm->xdpy, "XMoveResizeWindow");
 
-      XMoveResizeWindow(wm->xdpy,
-			decor->xwin,
-			decor->geom.x,
-			decor->geom.y,
-			decor->geom.width,
-			decor->geom.height);
+	  XMoveResizeWindow(wm->xdpy,
+			    decor->xwin,
+			    decor->geom.x,
+			    decor->geom.y,
+			    decor->geom.width,
+			    decor->geom.height);
 
-      mb_wm_util_async_untrap_x_errors();
+	  mb_wm_util_async_untrap_x_errors();
+
+	  decor->x_geom = decor->geom;
+	}
 
       /* Next up sort buttons */
       mb_wm_util_list_foreach(decor->buttons,
@@ -677,6 +813,8 @@ mb_wm_decor_destroy (MBWMObject* obj)
       decor->destroy_themedata = NULL;
     }
 
+  mb_wm_decor_grab_end (decor);
+
   mb_wm_decor_detach (decor);
 
   for (l = decor->buttons; l; l = l->next)
@@ -688,7 +826,13 @@ mb_wm_decor_destroy (MBWMObject* obj)
     }
 
   if (decor->buttons)
-    mb_wm_util_list_free (decor->buttons);
+    {
+      mb_wm_util_list_free (decor->buttons);
+      decor->buttons = NULL;
+    }
+
+  /* Wait for the verdict, or errors of the creation would go unclaimed */
+  mb_wm_decor_check_created (decor, True);
 
   if (decor->press_cb_id)
     mb_wm_main_context_x_event_handler_remove (ctx, ButtonPress,
@@ -792,11 +936,14 @@ mb_wm_decor_button_press_handler (XButtonEvent    *xev,
   MBWindowManager *wm;
   MBWMList        *transients = NULL;
   Bool             retval = True;
-  Bool             unref_parent_client = False;
 
   if (!button->realized || !decor || !decor->parent_client)
     return False;
 
+  /* Someone has the pointer, and the events are theirs */
+  if (decor->grab != MBWMDecorGrabNone)
+    return True;
+
   wm = decor->parent_client->wmref;
 
   mb_wm_object_ref (MB_WM_OBJECT(button));
@@ -853,7 +1000,7 @@ mb_wm_decor_button_press_handler (XButtonEvent    *xev,
 					xev->subwindow,
 					xev->button, 0, 0);
 
-	  XSync (wm->xdpy, False); /* Necessary */
+	  mb_wm_util_sync (wm->xdpy, False); /* Necessary */
 	  goto done;
 	}
       if (xev->type != ButtonPress)
@@ -879,7 +1026,7 @@ mb_wm_decor_button_press_handler (XButtonEvent    *xev,
 					xev->subwindow,
 					xev->button, 0, 0);
 
-	  XSync (wm->xdpy, False); /* Necessary */
+	  mb_wm_util_sync (wm->xdpy, False); /* Necessary */
 
 	  if (button->press)
 	    button->press(wm, button, button->userdata);
@@ -888,176 +1035,17 @@ mb_wm_decor_button_press_handler (XButtonEvent    *xev,
 	}
       else
 	{
-	  XEvent ev;
-	  int status;
-
 	  /*
 	   * First, call the custom function if any.
 	   */
 	  if (button->press)
 	    button->press(wm, button, button->userdata);
 
-	  mb_wm_util_async_trap_x_errors(wm->xdpy);
-	  status = XGrabPointer(wm->xdpy, xev->subwindow, False,
-			   ButtonPressMask|ButtonReleaseMask|
-			   PointerMotionMask|EnterWindowMask|LeaveWindowMask,
-			   GrabModeAsync,
-			   GrabModeAsync,
-			   None, None, CurrentTime);
-	  mb_wm_util_async_untrap_x_errors();
-	  if (status == GrabSuccess)
-	    {
-              /* set up release handler to catch ButtonRelease while we
-               * are spinning the main loop */
-	      decor->release_cb_id = mb_wm_main_context_x_event_handler_add (
-				 wm->main_ctx,
-			         xev->subwindow,
-			         ButtonRelease,
-			         (MBWMXEventFunc)mb_wm_decor_release_handler,
-			         decor);
-	      if (button->state == MBWMDecorButtonStateInactive)
-		{
-		  button->state = MBWMDecorButtonStatePressed;
-		  mb_wm_theme_paint_button (wm->theme, button);
-		}
-
-	      /* reference the client for the loop, since it could be
-	       * unreffed while we are handling events there */
-              mb_wm_object_ref (MB_WM_OBJECT(decor->parent_client));
-	      unref_parent_client = True;
-
-	      for (;;)
-		{
-		  /*
-		   * First of all, we make sure that all events are flushed
-		   * out (this is necessary to ensure that all the events we
-		   * are interested in are actually intercepted here).
-		   */
-		  XSync (wm->xdpy, False);
-
-		  /*
-		   * Someone might destroy the window while we are waiting for
-		   * the events here.
-		   */
-		  if (!button->realized)
-                  {
-                    /* if the window disappeared, ungrab was done by X.
-                       Just remove the handler */
-                    mb_wm_main_context_x_event_handler_remove (
-                                   wm->main_ctx, ButtonRelease,
-			           decor->release_cb_id);
-                    decor->release_cb_id = 0;
-		    retval = False;
-		    goto done;
-		  }
-
-                  if (!decor->release_cb_id)
-                    {
-                     /* the handler was called while we spinned the loop */
-		     if (button->state == MBWMDecorButtonStatePressed)
-		       {
-                         button->state = MBWMDecorButtonStateInactive;
-                         mb_wm_theme_paint_button (wm->theme, button);
-                       }
-		     retval = False;
-		     goto done;
-                    }
-
-		  if (XCheckMaskEvent(wm->xdpy,
-				      ButtonPressMask|ButtonReleaseMask|
-				      PointerMotionMask|EnterWindowMask|
-				      LeaveWindowMask,
-				      &ev))
-		    {
-		      switch (ev.type)
-			{
-			case MotionNotify:
-			  {
-			    XMotionEvent *pev = (XMotionEvent*)&ev;
-
-			    if (pev->x < xmin || pev->x > xmax ||
-				pev->y < ymin || pev->y > ymax)
-			      {
-				if (button->state ==
-				    MBWMDecorButtonStatePressed)
-				  {
-				    button->state =
-				      MBWMDecorButtonStateInactive;
-				    mb_wm_theme_paint_button (wm->theme,button);
-				  }
-			      }
-			    else
-			      {
-				if (button->state !=
-				    MBWMDecorButtonStatePressed)
-				  {
-				    button->state = MBWMDecorButtonStatePressed;
-				    mb_wm_theme_paint_button (wm->theme,button);
-				  }
-			      }
-			  }
-			  break;
-			case EnterNotify:
-			  if (button->state == MBWMDecorButtonStateInactive)
-			    {
-			      button->state = MBWMDecorButtonStatePressed;
-			      mb_wm_theme_paint_button (wm->theme, button);
-			    }
-			  break;
-			case LeaveNotify:
-			  if (button->state != MBWMDecorButtonStateInactive)
-			    {
-			      button->state = MBWMDecorButtonStateInactive;
-			      mb_wm_theme_paint_button (wm->theme, button);
-			    }
-			  break;
-			case ButtonRelease:
-			  {
-			    XButtonEvent *pev = (XButtonEvent*)&ev;
-
-			    if (button->state != MBWMDecorButtonStateInactive)
-			      {
-				button->state = MBWMDecorButtonStateInactive;
-				mb_wm_theme_paint_button (wm->theme, button);
-			      }
-
-			    XUngrabPointer (wm->xdpy, CurrentTime);
-			    XSync (wm->xdpy, False); /* necessary */
-
-                            mb_wm_main_context_x_event_handler_remove (
-                                   wm->main_ctx, ButtonRelease,
-			           decor->release_cb_id);
-                            decor->release_cb_id = 0;
-
-			    if (pev->x < xmin || pev->x > xmax ||
-				pev->y < ymin || pev->y > ymax)
-			      {
-				retval = False;
-				goto done;
-			      }
-
-			    if (button->release)
-			      button->release(wm, button, button->userdata);
-			    else
-			      mb_wm_decor_button_stock_button_action (button);
-
-			    retval = False;
-			    goto done;
-			  }
-			}
-		    }
-		  else
-		    {
-		      /*
-		       * No pending X event, so spin the main loop (this allows
-		       * things like timers to work.
-		       */
-		      if (!mb_wm_main_context_spin_loop (wm->main_ctx))
-                        /* no events, sleep a while so we don't busy loop */
-                        g_usleep (1000 * 100);
-		    }
-		}
-	    }
+	  /* The release (or the pointer leaving us) is dealt with by the
+	   * grab handlers */
+	  if (button->realized &&
+	      mb_wm_decor_grab_begin (decor, MBWMDecorGrabButton, button))
+	    mb_wm_decor_button_set_pressed (button, True);
 	}
 
       retval = False;
@@ -1066,8 +1054,6 @@ mb_wm_decor_button_press_handler (XButtonEvent    *xev,
  done:
   mb_wm_util_list_free (transients);
   mb_wm_object_unref (MB_WM_OBJECT(button));
-  if (unref_parent_client)
-    mb_wm_object_unref (MB_WM_OBJECT(decor->parent_client));
   return retval;
 }
 
@@ -1238,6 +1224,10 @@ mb_wm_decor_button_unrealize (MBWMDecorButton *button)
 
   if (!ctx)
 	  return;
+
+  if (button->decor->grab_button == button)
+    mb_wm_decor_grab_end (button->decor);
+
   /*
    * We are doing the job in the mb_wm_decor_button_unrealize() while the
    * decoration still exists.
@@ -1246,6 +1236,7 @@ mb_wm_decor_button_unrealize (MBWMDecorButton *button)
 					     button->press_cb_id);
   mb_wm_main_context_x_event_handler_remove (ctx, ButtonRelease,
 					     button->release_cb_id);
+  button->press_cb_id = button->release_cb_id = 0;
 }
 
 static void
@@ -51,6 +51,13 @@ typedef enum MBWMDecorDirtyState
   MBWMDecorDirtyFull  = 0xffffffff,
 } MBWMDecorDirtyState;
 
+typedef enum MBWMDecorGrab
+{
+  MBWMDecorGrabNone = 0,
+  MBWMDecorGrabDrag,       /* the window is being moved by its decor */
+  MBWMDecorGrabButton,     /* a button is held down */
+} MBWMDecorGrab;
+
 /**
  * A decor (that is, a description of one of the four edges of a window's
  * decorations); each decorated MBWindowManagerClient has four of these.
@@ -62,6 +69,7 @@ struct MBWMDecor
   Window                    xwin;
   MBWindowManagerClient    *parent_client;
   MBGeometry                geom;
+  MBGeometry                x_geom; /* as last sent to the server */
   MBWMDecorDirtyState       dirty;
   Bool                      absolute_packing;
   /**
@@ -74,8 +82,22 @@ struct MBWMDecor
   unsigned long             press_cb_id;
   unsigned long             release_cb_id;
 
+  /*
+   * While the pointer is grabbed the motion and release handlers carry on
+   * from the press; the main loop keeps running meanwhile.
+   */
+  MBWMDecorGrab             grab;
+  MBWMDecorButton          *grab_button;
+  unsigned long             motion_cb_id;
+  int                       grab_x, grab_y;           /* window at press */
+  int                       grab_root_x, grab_root_y; /* pointer at press */
+
   void                     *themedata;
   MBWMDecorDestroyUserData  destroy_themedata;
+
+  /* errors of the window creation, until we know whether it succeeded */
+  MBWMXErrorTrap           *create_trap;
+  Bool                      create_failed; /* then it is not tried again */
 };
 
 /**
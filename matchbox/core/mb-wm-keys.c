@@ -3,15 +3,19 @@
 #include <X11/XKBlib.h>
 
 /**
- * All the keybinding information: a list of keybindings and the current
+ * All the keybinding information: a table of keybindings and the current
  * masks for the various modifier keys; in MBWindowManager.
  *
  * \bug FIXME: Probably do want to hide these here
  */
 struct MBWMKeys
 {
-  /** Always points to first binding */
-  MBWMList *bindings;
+  /** MBWMKeyEntry, keyed by keysym and mask without lock_mask */
+  GHashTable *bindings;
+
+  /** Bindings added since mb_wm_keys_batch_begin(), with their traps */
+  MBWMList   *batch;
+  int         batch_depth;
 
   int MetaMask;
   int HyperMask;
@@ -23,6 +27,64 @@ struct MBWMKeys
   int lock_mask;
 };
 
+/* All the bindings for one keysym and (normalized) modifier mask */
+typedef struct MBWMKeyEntry
+{
+  KeySym    keysym;
+  int       mask;
+  MBWMList *bindings;
+} MBWMKeyEntry;
+
+typedef struct MBWMKeyPending
+{
+  MBWMKeyBinding *binding;
+  MBWMXErrorTrap *trap;
+} MBWMKeyPending;
+
+static guint
+key_entry_hash (gconstpointer p)
+{
+  const MBWMKeyEntry *entry = p;
+
+  return (guint) entry->keysym * 31 + entry->mask;
+}
+
+static gboolean
+key_entry_equal (gconstpointer a, gconstpointer b)
+{
+  const MBWMKeyEntry *e1 = a, *e2 = b;
+
+  return e1->keysym == e2->keysym && e1->mask == e2->mask;
+}
+
+static void
+key_entry_free (gpointer p)
+{
+  MBWMKeyEntry *entry = p;
+
+  mb_wm_util_list_free (entry->bindings);
+  free (entry);
+}
+
+static Bool
+key_entry_has_binding (MBWMKeyEntry *entry, MBWMKeyBinding *binding)
+{
+  MBWMList *l;
+
+  for (l = entry->bindings; l; l = l->next)
+    if (l->data == binding)
+      return True;
+
+  return False;
+}
+
+/* The mask bindings are looked up by: the locks must not make a difference */
+static int
+key_normalize_mask (MBWMKeys *keys, int mask)
+{
+  return mask & ~keys->lock_mask;
+}
+
 #if 0
 static Bool
 keysym_needs_shift (MBWindowManager *wm, KeySym keysym)
@@ -43,85 +105,235 @@ keysym_needs_shift (MBWindowManager *wm, KeySym keysym)
 }
 #endif
 
-static Bool
+static void
+key_binding_warn_grab (MBWMKeyBinding *key, int result)
+{
+  if (result == BadAccess)
+    mb_wm_util_warn ("Some other program is already using the key %s with modifiers %x as a binding\n",
+		     (XKeysymToString(key->keysym)) ? XKeysymToString (key->keysym) : "unknown",
+		     key->modifier_mask);
+  else
+    mb_wm_util_warn ("Unable to grab the key %s with modifiers %x as a binding\n",
+		     (XKeysymToString(key->keysym)) ? XKeysymToString (key->keysym) : "unknown",
+		     key->modifier_mask);
+}
+
+/*
+ * Issues the (un)grabs for the key with every combination of the lock
+ * modifiers. The grabs are covered by a deferred trap which is returned to
+ * be checked by the caller; nothing here waits for the server.
+ */
+static MBWMXErrorTrap *
 key_binding_set_grab (MBWindowManager *wm,
 		      MBWMKeyBinding  *key,
 		      Bool             ungrab)
 {
-  int ignored_mask = 0;
+  int             lock_mask;
+  int             ignored_mask = 0;
+  KeyCode         keycode;
+  MBWMXErrorTrap *trap = NULL;
 
   MBWM_ASSERT (wm->keys != NULL);
 
-  /* Needed to grab all Locked combo's too */
-  while (ignored_mask < (int) wm->keys->lock_mask)
-    {
-      if (ignored_mask & ~(wm->keys->lock_mask))
-	{
-	  ++ignored_mask;
-	  continue;
-	}
+  lock_mask = wm->keys->lock_mask;
+  keycode   = XKeysymToKeycode (wm->xdpy, key->keysym);
 
+  if (!ungrab)
+    trap = mb_wm_util_deferred_trap_x_errors (wm->xdpy);
+
+  /* Needed to grab all Locked combo's too; walks every subset of lock_mask */
+  do
+    {
       if (ungrab)
 	{
-	  MBWM_DBG ("ungrabbing %i , %i\n",
-		   XKeysymToKeycode(wm->xdpy, key->keysym),
-		   key->modifier_mask);
+	  MBWM_DBG ("ungrabbing %i , %i\n", keycode,
+		    key->modifier_mask | ignored_mask);
 
-	  XUngrabKey(wm->xdpy,
-		     XKeysymToKeycode(wm->xdpy, key->keysym),
+	  XUngrabKey(wm->xdpy, keycode,
 		     key->modifier_mask | ignored_mask,
 		     wm->root_win->xwindow);
 	}
       else
 	{
-	  int result;
-
-	  XSync(wm->xdpy, False);
-	  mb_wm_util_trap_x_errors();
-
 	  MBWM_DBG ("grabbing keycode: %i, keysym %li, mask: %i\n",
-		   XKeysymToKeycode(wm->xdpy, key->keysym),
-		   key->keysym,
-		   key->modifier_mask | ignored_mask);
+		    keycode, key->keysym, key->modifier_mask | ignored_mask);
 
-	  XGrabKey(wm->xdpy, XKeysymToKeycode(wm->xdpy, key->keysym),
+	  XGrabKey(wm->xdpy, keycode,
 		   key->modifier_mask | ignored_mask,
 		   wm->root_win->xwindow, True, GrabModeAsync, GrabModeAsync);
+	}
 
-	  result = mb_wm_util_untrap_x_errors();
+      ignored_mask = (ignored_mask - lock_mask) & lock_mask;
+    }
+  while (ignored_mask);
 
-	  if (result != Success)
-	    {
-	      if (result == BadAccess)
-		mb_wm_util_warn ("Some other program is already using the key %s with modifiers %x as a binding\n",
-				 (XKeysymToString(key->keysym)) ? XKeysymToString (key->keysym) : "unknown",
-				 key->modifier_mask | ignored_mask );
-	      else
-		mb_wm_util_warn ("Unable to grab the key %s with modifiers %x as a binding\n",
-				 (XKeysymToString(key->keysym)) ? XKeysymToString (key->keysym) : "unknown",
-				 key->modifier_mask | ignored_mask );
-	      return False;
-	    }
+  if (trap)
+    mb_wm_util_deferred_untrap_x_errors (trap);
+
+  return trap;
+}
+
+static void
+key_binding_insert (MBWMKeys *keys, MBWMKeyBinding *binding)
+{
+  MBWMKeyEntry  lookup, *entry;
+
+  lookup.keysym = binding->keysym;
+  lookup.mask   = key_normalize_mask (keys, binding->modifier_mask);
+
+  entry = g_hash_table_lookup (keys->bindings, &lookup);
+
+  if (!entry)
+    {
+      entry = mb_wm_util_malloc0 (sizeof (MBWMKeyEntry));
+      entry->keysym = lookup.keysym;
+      entry->mask   = lookup.mask;
+      g_hash_table_insert (keys->bindings, entry, entry);
+    }
+
+  entry->bindings = mb_wm_util_list_append (entry->bindings, binding);
+}
+
+/* Drops the binding from the table, so it is no longer dispatched */
+static void
+key_binding_unlink (MBWMKeys *keys, MBWMKeyBinding *binding)
+{
+  MBWMKeyEntry  lookup, *entry;
+
+  lookup.keysym = binding->keysym;
+  lookup.mask   = key_normalize_mask (keys, binding->modifier_mask);
+
+  entry = g_hash_table_lookup (keys->bindings, &lookup);
+
+  if (entry)
+    {
+      entry->bindings = mb_wm_util_list_remove (entry->bindings, binding);
+
+      if (!entry->bindings)
+	g_hash_table_remove (keys->bindings, entry);
+    }
+}
+
+/*
+ * Between mb_wm_keys_batch_begin() and mb_wm_keys_batch_end() the grabs for
+ * new bindings are not checked as they are added, so adding any number of
+ * bindings costs a single round-trip. Bindings whose grab fails are
+ * reported and removed in mb_wm_keys_batch_end(), which hands them back.
+ */
+void
+mb_wm_keys_batch_begin (MBWindowManager *wm)
+{
+  MBWM_ASSERT (wm->keys != NULL);
+
+  wm->keys->batch_depth++;
+}
+
+MBWMList *
+mb_wm_keys_batch_end (MBWindowManager *wm)
+{
+  MBWMKeys *keys = wm->keys;
+  MBWMList *l, *failed = NULL;
+
+  MBWM_ASSERT (keys != NULL && keys->batch_depth > 0);
+
+  if (--keys->batch_depth)
+    return NULL;
+
+  /* The first check does the round-trip, which settles all the others */
+  for (l = keys->batch; l; l = l->next)
+    {
+      MBWMKeyPending *pending = l->data;
+      int             result;
+
+      result = mb_wm_util_deferred_x_error (pending->trap, True);
+      mb_wm_util_deferred_x_error_free (pending->trap);
+
+      if (result != Success)
+	{
+	  key_binding_warn_grab (pending->binding, result);
+	  key_binding_set_grab (wm, pending->binding, True);
+	  key_binding_unlink (keys, pending->binding);
+
+	  failed = mb_wm_util_list_append (failed, pending->binding);
 	}
 
-      ++ignored_mask;
+      free (pending);
     }
 
-  return True;
+  mb_wm_util_list_free (keys->batch);
+  keys->batch = NULL;
+
+  return failed;
+}
+
+static void
+key_binding_remove_one (gpointer key, gpointer value, gpointer userdata)
+{
+  MBWindowManager *wm = userdata;
+  MBWMKeyEntry    *entry = value;
+  MBWMList        *l;
+
+  for (l = entry->bindings; l; l = l->next)
+    {
+      MBWMKeyBinding *binding = l->data;
+
+      key_binding_set_grab (wm, binding, True);
+
+      if (binding->destroy)
+	binding->destroy (wm, binding, binding->userdata);
+
+      free (binding);
+    }
 }
 
 void
 mb_wm_keys_binding_remove_all (MBWindowManager    *wm)
 {
+  MBWMList *l;
+
+  MBWM_ASSERT (wm->keys != NULL);
+
+  for (l = wm->keys->batch; l; l = l->next)
+    {
+      MBWMKeyPending *pending = l->data;
 
+      mb_wm_util_deferred_x_error_free (pending->trap);
+      free (pending);
+    }
+
+  mb_wm_util_list_free (wm->keys->batch);
+  wm->keys->batch = NULL;
+
+  g_hash_table_foreach (wm->keys->bindings, key_binding_remove_one, wm);
+  g_hash_table_remove_all (wm->keys->bindings);
 }
 
 void
 mb_wm_keys_binding_remove (MBWindowManager    *wm,
 			   MBWMKeyBinding     *binding)
 {
+  MBWMKeys *keys = wm->keys;
+  MBWMList *l;
+
+  MBWM_ASSERT (keys != NULL);
 
   key_binding_set_grab (wm, binding, True);
+
+  for (l = keys->batch; l; l = l->next)
+    {
+      MBWMKeyPending *pending = l->data;
+
+      if (pending->binding == binding)
+	{
+	  keys->batch = mb_wm_util_list_remove (keys->batch, pending);
+	  mb_wm_util_deferred_x_error_free (pending->trap);
+	  free (pending);
+	  break;
+	}
+    }
+
+  /* The binding itself still belongs to the caller */
+  key_binding_unlink (keys, binding);
 }
 
 MBWMKeyBinding*
@@ -134,6 +346,8 @@ mb_wm_keys_binding_add (MBWindowManager    *wm,
 {
   MBWMKeyBinding *binding = NULL;
   MBWMKeys       *keys = wm->keys;
+  MBWMXErrorTrap *trap;
+  int             result;
 
   MBWM_ASSERT (wm->keys != NULL);
 
@@ -145,13 +359,31 @@ mb_wm_keys_binding_add (MBWindowManager    *wm,
   binding->destroy       = destroy_func;
   binding->userdata      = userdata;
 
-  if (key_binding_set_grab (wm, binding, False))
+  trap = key_binding_set_grab (wm, binding, False);
+
+  if (keys->batch_depth)
+    {
+      MBWMKeyPending *pending = mb_wm_util_malloc0 (sizeof (MBWMKeyPending));
+
+      pending->binding = binding;
+      pending->trap    = trap;
+      keys->batch = mb_wm_util_list_append (keys->batch, pending);
+
+      key_binding_insert (keys, binding);
+      return binding;
+    }
+
+  result = mb_wm_util_deferred_x_error (trap, True);
+  mb_wm_util_deferred_x_error_free (trap);
+
+  if (result == Success)
     {
-      keys->bindings = mb_wm_util_list_append(keys->bindings, binding);
+      key_binding_insert (keys, binding);
       return binding;
     }
 
   /* Grab failed */
+  key_binding_warn_grab (binding, result);
   free(binding);
   return NULL;
 }
@@ -277,58 +509,48 @@ mb_wm_keys_press (MBWindowManager *wm,
 		  KeySym           keysym,
 		  int              modifier_mask)
 {
-  MBWMList       *iter;
-  MBWMKeyBinding *binding;
+  MBWMKeyEntry    lookup, *entry;
+  MBWMList       *iter, *pressed = NULL;
 
   if (!wm->keys)
     return;
 
   MBWM_DBG ("Looking up keysym <%li>, (mask %i)\n", keysym, modifier_mask);
 
-  iter = wm->keys->bindings;
+  lookup.keysym = keysym;
+  lookup.mask   = key_normalize_mask (wm->keys, modifier_mask);
 
-  while (iter)
-    {
-      int ignored_mask = 0;
+  entry = g_hash_table_lookup (wm->keys->bindings, &lookup);
 
-      binding = (MBWMKeyBinding*)iter->data;
+  if (!entry)
+    return;
 
-      if (!binding->pressed ||
-           binding->keysym != keysym)
-        goto next_item;
+  /*
+   * The callbacks may add or remove bindings, even emptying and freeing
+   * this entry, so walk a copy and look every binding up again before
+   * calling it.
+   */
+  for (iter = entry->bindings; iter; iter = mb_wm_util_list_next (iter))
+    pressed = mb_wm_util_list_append (pressed, iter->data);
 
-      MBWM_DBG ("Checking up keysym <%li>, ( mask %i )",
-	       binding->keysym,
-	       binding->modifier_mask);
+  for (iter = pressed; iter; iter = mb_wm_util_list_next (iter))
+    {
+      MBWMKeyBinding *binding = iter->data;
 
-      /* FIXME: Assumes multiple bindings per key */
-      while (ignored_mask < (int) wm->keys->lock_mask)
-	{
-	  if (ignored_mask & ~(wm->keys->lock_mask))
-	    {
-	      ++ignored_mask;
-	      continue;
-	    }
+      entry = g_hash_table_lookup (wm->keys->bindings, &lookup);
 
-	  /*
-	   * If we are here we already know that the binding->pressed function
-	   * pointer is not NULL and the keysym is matched, only the modifier
-	   * mask must be checked.
-	   */
-	  if (binding->modifier_mask == (modifier_mask & ~ignored_mask))
-	    {
-	      binding->pressed(wm, binding, binding->userdata);
-	      break;
-	    }
+      if (!entry)
+	break;
 
-	  ++ignored_mask;
-	}
+      if (!key_entry_has_binding (entry, binding))
+	continue;
 
-next_item:
-      iter = mb_wm_util_list_next(iter);
+      if (binding->pressed)
+	binding->pressed(wm, binding, binding->userdata);
     }
-}
 
+  mb_wm_util_list_free (pressed);
+}
 
 Bool
 mb_wm_keys_init(MBWindowManager *wm)
@@ -343,6 +565,9 @@ mb_wm_keys_init(MBWindowManager *wm)
 
   keys = wm->keys = mb_wm_util_malloc0(sizeof(MBWMKeys));
 
+  keys->bindings = g_hash_table_new_full (key_entry_hash, key_entry_equal,
+					  NULL, key_entry_free);
+
   /* Figure out modifier masks */
 
   kpm = mod_map->max_keypermod;
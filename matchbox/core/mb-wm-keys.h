@@ -23,9 +23,14 @@
 
 #include <matchbox/core/mb-wm.h>
 
+/* Ungrabs all the bindings, calls their destroy functions and frees them */
 void
 mb_wm_keys_binding_remove_all (MBWindowManager    *wm);
 
+/*
+ * Ungrabs the binding, which is then no longer called; it is not freed and
+ * its destroy function is not called, that is left to the caller.
+ */
 void
 mb_wm_keys_binding_remove (MBWindowManager    *wm,
 			   MBWMKeyBinding     *binding);
@@ -44,6 +49,17 @@ mb_wm_keys_binding_add_with_spec (MBWindowManager    *wm,
 				  MBWMKeyDestroyFunc  destroy_func,
 				  void               *userdata);
 
+void
+mb_wm_keys_batch_begin (MBWindowManager *wm);
+
+/*
+ * Returns the bindings of the batch whose grab failed, if any.  Like those
+ * given to mb_wm_keys_binding_remove() they are no longer called and still
+ * belong to the caller; the list is to be freed with mb_wm_util_list_free().
+ */
+MBWMList *
+mb_wm_keys_batch_end (MBWindowManager *wm);
+
 void
 mb_wm_keys_press (MBWindowManager *wm,
 		  KeySym           keysym,
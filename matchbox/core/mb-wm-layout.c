@@ -12,6 +12,26 @@ mb_wm_layout_real_layout_free (MBWMLayout *layout, MBGeometry * avail_geom);
 static void
 mb_wm_layout_real_layout_fullscreen (MBWMLayout *layout, MBGeometry * avail_geom);
 
+/*
+ * What the panel and input passes depend on, for each client reserving
+ * space; if none of it changed, neither did the space they leave free.
+ */
+typedef struct MBWMLayoutReserver
+{
+  MBWMClientLayoutHints hints;
+  MBGeometry            coverage;
+  Bool                  transient_for_fullscreen;
+} MBWMLayoutReserver;
+
+#define LAYOUT_RESERVE_HINTS (LayoutPrefReserveEdgeNorth |	\
+			      LayoutPrefReserveEdgeSouth |	\
+			      LayoutPrefReserveEdgeEast  |	\
+			      LayoutPrefReserveEdgeWest  |	\
+			      LayoutPrefReserveNorth     |	\
+			      LayoutPrefReserveSouth     |	\
+			      LayoutPrefReserveEast      |	\
+			      LayoutPrefReserveWest)
+
 static void
 mb_wm_layout_class_init (MBWMObjectClass *klass)
 {
@@ -31,6 +51,9 @@ mb_wm_layout_class_init (MBWMObjectClass *klass)
 static void
 mb_wm_layout_destroy (MBWMObject *this)
 {
+  MBWMLayout *layout = MB_WM_LAYOUT (this);
+
+  free (layout->reservers);
 }
 
 static int
@@ -676,12 +699,76 @@ mb_wm_layout_real_layout_fullscreen (MBWMLayout *layout, MBGeometry * avail_geom
       }
 }
 
+/* Returns the number of clients reserving space and their state */
+static int
+mb_wm_layout_get_reservers (MBWMLayout *layout, MBWMLayoutReserver **reservers)
+{
+  MBWindowManager       *wm = layout->wm;
+  MBWindowManagerClient *client;
+  int                    n = 0;
+
+  mb_wm_stack_enumerate (wm, client)
+    if (mb_wm_client_get_layout_hints (client) & LAYOUT_RESERVE_HINTS)
+      n++;
+
+  *reservers = NULL;
+
+  if (!n)
+    return 0;
+
+  /* Zeroed, so the entries can be compared with memcmp() */
+  *reservers = mb_wm_util_malloc0 (n * sizeof (MBWMLayoutReserver));
+  n = 0;
+
+  mb_wm_stack_enumerate (wm, client)
+    if (mb_wm_client_get_layout_hints (client) & LAYOUT_RESERVE_HINTS)
+      {
+	MBWMLayoutReserver *r = &(*reservers)[n++];
+
+	r->hints = mb_wm_client_get_layout_hints (client);
+	mb_wm_client_get_coverage (client, &r->coverage);
+
+	r->transient_for_fullscreen =
+	  client->transient_for &&
+	  (client->transient_for->window->ewmh_state &
+	   MBWMClientWindowEWMHStateFullscreen);
+      }
+
+  return n;
+}
+
+static Bool
+mb_wm_layout_reservers_equal (MBWMLayoutReserver *a, int n_a,
+			      MBWMLayoutReserver *b, int n_b)
+{
+  if (n_a != n_b)
+    return False;
+
+  return !n_a || !memcmp (a, b, n_a * sizeof (MBWMLayoutReserver));
+}
+
+static void
+mb_wm_layout_run_pass (MBWMLayout  *layout,
+		       const char  *name,
+		       void       (*pass) (MBWMLayout *, MBGeometry *),
+		       MBGeometry  *avail_geom)
+{
+#if MBWM_WANT_DEBUG
+  gint64 start = g_get_monotonic_time ();
+#endif
+
+  pass (layout, avail_geom);
+
+  MBWM_NOTE (LAYOUT, "%s pass took %" G_GINT64_FORMAT "us, left %dx%d%+d%+d",
+	     name, g_get_monotonic_time () - start, MBWM_GEOMETRY (avail_geom));
+}
+
 static void
 mb_wm_layout_real_update (MBWMLayout * layout)
 {
   MBWMLayoutClass       *klass;
   MBWindowManager       *wm = layout->wm;
-  MBGeometry             avail_geom;
+  MBGeometry             avail_geom, display_geom;
 
   klass = MB_WM_LAYOUT_CLASS (MB_WM_OBJECT_GET_CLASS (layout));
 
@@ -725,13 +812,72 @@ mb_wm_layout_real_update (MBWMLayout * layout)
 
  */
 
-  mb_wm_get_display_geometry (wm, &avail_geom, True);
-  klass->layout_panels (layout, &avail_geom);
-  klass->layout_input  (layout, &avail_geom);
-  klass->layout_free   (layout, &avail_geom);
+  mb_wm_get_display_geometry (wm, &display_geom, True);
+  avail_geom = display_geom;
+
+  /*
+   * The reserved area can only be reused if we know what the passes
+   * computing it look at, i.e., if a subclass has not replaced them.
+   */
+  if (klass->layout_panels == mb_wm_layout_real_layout_panels &&
+      klass->layout_input  == mb_wm_layout_real_layout_input)
+    {
+      MBWMLayoutReserver *before, *after;
+      int                 n_before, n_after;
+
+      n_before = mb_wm_layout_get_reservers (layout, &before);
+
+      if (layout->reserved_valid &&
+	  mb_geometry_compare (&display_geom, &layout->reserved_display) &&
+	  mb_wm_layout_reservers_equal (before, n_before,
+					layout->reservers,
+					layout->n_reservers))
+	{
+	  MBWM_NOTE (LAYOUT, "reserved area unchanged, %dx%d%+d%+d",
+		     MBWM_GEOMETRY (&layout->reserved_geom));
+
+	  avail_geom = layout->reserved_geom;
+	  free (before);
+	}
+      else
+	{
+	  mb_wm_layout_run_pass (layout, "panels",
+				 klass->layout_panels, &avail_geom);
+	  mb_wm_layout_run_pass (layout, "input",
+				 klass->layout_input, &avail_geom);
+
+	  /*
+	   * Only trust the result once the passes have nothing left to
+	   * change; otherwise the next update goes through them again.
+	   */
+	  n_after = mb_wm_layout_get_reservers (layout, &after);
+
+	  free (layout->reservers);
+	  layout->reservers        = after;
+	  layout->n_reservers      = n_after;
+	  layout->reserved_display = display_geom;
+	  layout->reserved_geom    = avail_geom;
+	  layout->reserved_valid   =
+	    mb_wm_layout_reservers_equal (before, n_before, after, n_after);
+
+	  free (before);
+	}
+    }
+  else
+    {
+      layout->reserved_valid = False;
+
+      mb_wm_layout_run_pass (layout, "panels",
+			     klass->layout_panels, &avail_geom);
+      mb_wm_layout_run_pass (layout, "input",
+			     klass->layout_input, &avail_geom);
+    }
+
+  mb_wm_layout_run_pass (layout, "free", klass->layout_free, &avail_geom);
 
-  mb_wm_get_display_geometry (wm, &avail_geom, True);
-  klass->layout_fullscreen (layout, &avail_geom);
+  avail_geom = display_geom;
+  mb_wm_layout_run_pass (layout, "fullscreen",
+			 klass->layout_fullscreen, &avail_geom);
 }
 
 void
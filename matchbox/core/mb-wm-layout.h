@@ -35,6 +35,14 @@ struct MBWMLayout
   MBWMObject    parent;
 
   MBWindowManager *wm;
+
+  /* Outcome of the panel and input passes, reused while the reserving
+   * clients and the display geometry stay the same */
+  Bool                       reserved_valid;
+  MBGeometry                 reserved_display;
+  MBGeometry                 reserved_geom;
+  struct MBWMLayoutReserver *reservers;
+  int                        n_reservers;
 };
 
 /**
@@ -9,50 +9,12 @@
 #include <X11/extensions/Xdamage.h>
 #endif
 
-#define MBWM_CTX_MAX_TIMEOUT 100
-
-#if MBWM_WANT_DEBUG
-
-static const char *MBWMDEBUGEvents[] = {
-    "error",
-    "reply",
-    "KeyPress",
-    "KeyRelease",
-    "ButtonPress",
-    "ButtonRelease",
-    "MotionNotify",
-    "EnterNotify",
-    "LeaveNotify",
-    "FocusIn",
-    "FocusOut",
-    "KeymapNotify",
-    "Expose",
-    "GraphicsExpose",
-    "NoExpose",
-    "VisibilityNotify",
-    "CreateNotify",
-    "DestroyNotify",
-    "UnmapNotify",
-    "MapNotify",
-    "MapRequest",
-    "ReparentNotify",
-    "ConfigureNotify",
-    "ConfigureRequest",
-    "GravityNotify",
-    "ResizeRequest",
-    "CirculateNotify",
-    "CirculateRequest",
-    "PropertyNotify",
-    "SelectionClear",
-    "SelectionRequest",
-    "SelectionNotify",
-    "ColormapNotify",
-    "ClientMessage",
-    "MappingNotify",
-};
-
+#ifdef HAVE_XEXT
+#include <X11/extensions/shape.h>
 #endif
 
+#define MBWM_CTX_MAX_TIMEOUT 100
+
 #if ! USE_GLIB_MAINLOOP
 static Bool
 mb_wm_main_context_check_timeouts (MBWMMainContext *ctx);
@@ -221,6 +183,8 @@ mb_wm_main_context_handle_x_event (XEvent          *xev,
   nesting++;
 
   MBWindowManager *wm = ctx->wm;
+  gint64           start = nesting == 1 ? g_get_monotonic_time () : 0;
+  unsigned long    start_request = 0;
 #if (MBWM_WANT_DEBUG)
   MBWMList        *iter;
   Window           xwin = xev->xany.window;
@@ -232,8 +196,8 @@ mb_wm_main_context_handle_x_event (XEvent          *xev,
       ev_client = mb_wm_managed_client_from_xwindow(wm, xev->xany.window);
 
       printf ("  @ XEvent: '%s:%i' for %lx %s%s\n",
-	      xev->type < sizeof (MBWMDEBUGEvents)/sizeof(MBWMDEBUGEvents[0])
-	      ? MBWMDEBUGEvents[xev->type] : "unknown",
+	      mb_wm_stats_event_name (xev->type)
+	      ? mb_wm_stats_event_name (xev->type) : "unknown",
 	      xev->type,
 	      xev->xany.window,
 	      xev->xany.window == wm->root_win->xwindow ? "(root)" : "",
@@ -292,6 +256,23 @@ mb_wm_main_context_handle_x_event (XEvent          *xev,
     }
 #endif
 
+  /* Nested dispatches are accounted to the outermost event */
+  if (nesting == 1)
+    {
+      const char *name = mb_wm_stats_event_name (xev->type);
+
+      start_request    = NextRequest (wm->xdpy);
+      ctx->event_start = start;
+
+      mb_wm_stats_x_section_begin (wm->xdpy, name ? name : "extension event");
+    }
+
+  MBWM_SPAN_BEGIN ("x-event", mb_wm_stats_event_name (xev->type),
+		   xev->xany.window);
+
+  if (UNLIKELY (mb_wm_record_on))
+    mb_wm_record_event (wm, xev);
+
 #if ENABLE_COMPOSITE
   if (xev->type == wm->damage_event_base + XDamageNotify)
     {
@@ -300,6 +281,16 @@ mb_wm_main_context_handle_x_event (XEvent          *xev,
 			       xev->xany.window);
     }
   else
+#endif
+#ifdef HAVE_XEXT
+  if (wm->shape_event_base &&
+      xev->type == wm->shape_event_base + ShapeNotify)
+    {
+      call_handlers_for_event (ctx->event_funcs.shape_notify,
+			       xev,
+			       ((XShapeEvent *) xev)->window);
+    }
+  else
 #endif
   switch (xev->type)
     {
@@ -380,6 +371,15 @@ mb_wm_main_context_handle_x_event (XEvent          *xev,
       break;
     }
 
+  MBWM_SPAN_END ("x-event");
+
+  if (nesting == 1)
+    {
+      mb_wm_stats_x_section_end ();
+      mb_wm_stats_event (wm, xev->type, start, start_request);
+      ctx->event_start = 0;
+    }
+
   nesting--;
   /* We can't delete the handlers if we've been called from
    * ourself as we'll destroy the lists we're iterating over.
@@ -475,7 +475,7 @@ mb_wm_main_context_x_event_handler_add (MBWMMainContext *ctx,
 {
   static unsigned long    ids = 0;
   MBWMXEventFuncInfo    * func_info;
-#if ENABLE_COMPOSITE
+#if ENABLE_COMPOSITE || defined(HAVE_XEXT)
   MBWindowManager       * wm = ctx->wm;
 #endif
 
@@ -495,6 +495,14 @@ mb_wm_main_context_x_event_handler_add (MBWMMainContext *ctx,
 	mb_wm_util_list_append (ctx->event_funcs.damage_notify, func_info);
     }
   else
+#endif
+#ifdef HAVE_XEXT
+  if (wm->shape_event_base && type == wm->shape_event_base + ShapeNotify)
+    {
+      ctx->event_funcs.shape_notify =
+	mb_wm_util_list_append (ctx->event_funcs.shape_notify, func_info);
+    }
+  else
 #endif
   switch (type)
     {
@@ -589,7 +597,7 @@ mb_wm_list_remove_deleted_handlers (MBWMList **l_start)
 
           memset (info, 0, sizeof(*info));
 	  free (info);
-	  free (l);
+	  mb_wm_util_list_free_item (l);
 
 	  l = next;
 	} else {
@@ -686,6 +694,14 @@ mb_wm_main_context_remove_deleted_handlers (MBWMMainContext *ctx)
       ctx->event_funcs.deleted_damage_notify = False;
     }
 #endif
+
+#ifdef HAVE_XEXT
+  if (ctx->event_funcs.deleted_shape_notify)
+    {
+      mb_wm_list_remove_deleted_handlers (&ctx->event_funcs.shape_notify);
+      ctx->event_funcs.deleted_shape_notify = False;
+    }
+#endif
 }
 
 void
@@ -696,14 +712,24 @@ mb_wm_main_context_x_event_handler_remove (MBWMMainContext *ctx,
   MBWMList        * l = NULL;
   MBWMList        **l_start = NULL;
 
-#if ENABLE_COMPOSITE
+#if ENABLE_COMPOSITE || defined(HAVE_XEXT)
   MBWindowManager * wm = ctx->wm;
+#endif
 
+#if ENABLE_COMPOSITE
   if (type == wm->damage_event_base + XDamageNotify)
     {
       l_start = &ctx->event_funcs.damage_notify;
     }
   else
+#endif
+#ifdef HAVE_XEXT
+  if (wm->shape_event_base && type == wm->shape_event_base + ShapeNotify)
+    {
+      ctx->event_funcs.deleted_shape_notify = True;
+      l_start = &ctx->event_funcs.shape_notify;
+    }
+  else
 #endif
   switch (type)
     {
@@ -853,7 +879,7 @@ mb_wm_main_context_check_timeouts (MBWMMainContext *ctx)
 	    next->prev = prev;
 
 	  free (tinfo);
-	  free (l);
+	  mb_wm_util_list_free_item (l);
 
 	  l = next;
 	}
@@ -922,7 +948,7 @@ mb_wm_main_context_timeout_handler_remove (MBWMMainContext *ctx,
 	    next->prev = prev;
 
 	  free (info);
-	  free (l);
+	  mb_wm_util_list_free_item (l);
 
 	  return;
 	}
@@ -997,7 +1023,7 @@ mb_wm_main_context_fd_watch_remove (MBWMMainContext *ctx,
 	    next->prev = prev;
 
 	  free (info);
-	  free (l);
+	  mb_wm_util_list_free_item (l);
 
 	  return;
 	}
@@ -1119,7 +1145,7 @@ mb_wm_main_context_check_fd_watches (MBWMMainContext * ctx)
 		next->prev = prev;
 
 	      free (info);
-	      free (l);
+	      mb_wm_util_list_free_item (l);
 
 	      ctx->n_poll_fds--;
 
@@ -70,6 +70,10 @@ typedef struct MBWMEventFuncs
   Bool      deleted_damage_notify;
 #endif
 
+  /* SHAPE only; always here, so the layout does not depend on config.h */
+  MBWMList *shape_notify;
+  Bool      deleted_shape_notify;
+
 #if ! USE_GLIB_MAINLOOP
   MBWMList *timeout;
   MBWMList *fd_watch;
@@ -93,6 +97,9 @@ struct MBWMMainContext
   struct pollfd   *poll_fds;
   int              n_poll_fds;
   Bool             poll_cache_dirty;
+
+  /** When the X event being handled, or the outermost one, came in */
+  gint64           event_start;
 };
 
 /**
@@ -94,6 +94,7 @@ typedef enum MBWMObjectProp
     MBWMObjectPropCompMgrClutterEffectBehaviour = _MKOPROP(30, void*),
 
     MBWMObjectPropDpy                     = _MKOPROP(31, void*),
+    MBWMObjectPropClientWindowCookies     = _MKOPROP(32, void*),
 
     _MBWMObjectPropLastGlobal = 0x00fffff0,
   }
@@ -26,53 +26,165 @@
 
 static MBWMObjectClassInfo **ObjectClassesInfo  = NULL;
 static MBWMObjectClass     **ObjectClasses  = NULL;
+static MBWMObjectClassStats  *ObjectClassesStats = NULL;
 static int                   ObjectClassesAllocated = 0;
 static int                   NObjectClasses = 0;
 
 #if MBWM_WANT_DEBUG
-#define MBWM_OBJECT_TRACE_DEPTH 3
+#define MBWM_OBJECT_TRACE_DEPTH 8
+
+/*
+ * Where a sampled object was allocated.  Only the return addresses are
+ * kept; they are turned into symbols by mb_wm_object_dump().
+ */
+typedef struct MBWMObjectTrace
+{
+  unsigned long  type;
+  int            depth;
+  void          *frames[MBWM_OBJECT_TRACE_DEPTH];
+  unsigned int   count;  /* objects sharing the trace, when dumping */
+} MBWMObjectTrace;
+
 /*
- * Increased for each ref call and decreased for each unref call
+ * 1 in object_trace_sample allocations is traced, 1 in 64 by default;
+ * MB_WM_OBJECT_TRACE_SAMPLE=N changes the rate, N=1 traces every one.
  */
-MBWMList *alloc_objects = NULL;
+static GHashTable   *object_traces = NULL; /* MBWMObject* -> MBWMObjectTrace */
+static unsigned int  object_trace_sample = 64;
+
+static void
+mb_wm_object_trace_init (void)
+{
+  const char *sample = getenv ("MB_WM_OBJECT_TRACE_SAMPLE");
+
+  if (object_traces)
+    return;
+
+  if (sample)
+    {
+      char *end;
+      long  n = strtol (sample, &end, 10);
+
+      if (end != sample && !*end && n > 0 && n <= G_MAXINT)
+	object_trace_sample = n;
+      else
+	g_warning ("Ignoring bad MB_WM_OBJECT_TRACE_SAMPLE '%s'", sample);
+    }
+
+  object_traces = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					 NULL, g_free);
+}
+
+static guint
+mb_wm_object_trace_hash (gconstpointer key)
+{
+  const MBWMObjectTrace *trace = key;
+  guint                  hash = trace->type;
+  int                    i;
 
+  for (i = 0; i < trace->depth; ++i)
+    hash = hash * 31 + GPOINTER_TO_UINT (trace->frames[i]);
+
+  return hash;
+}
+
+static gboolean
+mb_wm_object_trace_equal (gconstpointer a, gconstpointer b)
+{
+  const MBWMObjectTrace *ta = a, *tb = b;
+
+  return ta->type == tb->type && ta->depth == tb->depth &&
+    !memcmp (ta->frames, tb->frames, ta->depth * sizeof (void *));
+}
+
+static gint
+mb_wm_object_trace_compare (gconstpointer a, gconstpointer b)
+{
+  const MBWMObjectTrace *ta = *(MBWMObjectTrace * const *) a;
+  const MBWMObjectTrace *tb = *(MBWMObjectTrace * const *) b;
+
+  return (ta->count < tb->count) - (ta->count > tb->count);
+}
+
+/*
+ * Lists the traced live objects, those allocated from the same place
+ * together, the most numerous first.
+ */
 void
 mb_wm_object_dump ()
 {
-  MBWMList * l = alloc_objects;
+  GHashTable       *sites;
+  GHashTableIter    iter;
+  gpointer          value;
+  MBWMObjectTrace **sorted;
+  int               n = 0, i, j;
 
-  if (!l)
+  if (!object_traces || !g_hash_table_size (object_traces))
     {
-      fprintf (stderr, "=== There currently are no allocated objects === \n");
+      fprintf (stderr, "=== There currently are no traced objects === \n");
       return;
     }
 
-  fprintf (stderr, "=== Currently allocated objects === \n");
+  sites = g_hash_table_new (mb_wm_object_trace_hash,
+			    mb_wm_object_trace_equal);
+
+  g_hash_table_iter_init (&iter, object_traces);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MBWMObjectTrace *trace = value;
+      MBWMObjectTrace *site = g_hash_table_lookup (sites, trace);
+
+      if (!site)
+	{
+	  site = trace;
+	  site->count = 0;
+	  g_hash_table_insert (sites, site, site);
+	}
+
+      site->count++;
+    }
+
+  sorted = g_new (MBWMObjectTrace *, g_hash_table_size (sites));
+
+  g_hash_table_iter_init (&iter, sites);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    sorted[n++] = value;
 
-  while (l)
+  qsort (sorted, n, sizeof (MBWMObjectTrace *), mb_wm_object_trace_compare);
+
+  fprintf (stderr, "=== Currently allocated objects, 1 in %u traced === \n",
+	   object_trace_sample);
+
+  for (i = 0; i < n; ++i)
     {
-      int i;
-      MBWMObject * o = l->data;
-      const MBWMObjectClass * k = MB_WM_OBJECT_GET_CLASS (o);
+      MBWMObjectTrace *site = sorted[i];
+      char           **symbols;
 
-      fprintf (stderr, "Object of type %s, allocated from:\n",
-	       k->klass_name);
+      fprintf (stderr, "%u object(s) of type %s, allocated from:\n",
+	       site->count, ObjectClasses[site->type - 1]->klass_name);
 
+      symbols = backtrace_symbols (site->frames, site->depth);
 
-      for (i = 1; i < MBWM_OBJECT_TRACE_DEPTH; ++i)
+      /* The first frame is mb_wm_object_new() itself */
+      for (j = 1; j < site->depth; ++j)
 	{
-	  char * s = o->trace_strings[i];
+	  char * s = symbols ? symbols[j] : NULL;
 	  while (s && *s && *s != '(')
 	    s++;
 
-	  fprintf (stderr, "    %s\n", s);
+	  if (s && *s)
+	    fprintf (stderr, "    %s\n", s);
+	  else
+	    fprintf (stderr, "    %p\n", site->frames[j]);
 	}
 
-      l = l->next;
+      free (symbols);
     }
 
   fprintf (stderr, "=== Currently allocated objects end === \n");
 
+  g_free (sorted);
+  g_hash_table_destroy (sites);
 }
 
 #endif
@@ -88,10 +200,16 @@ mb_wm_object_init(void)
       ObjectClasses = mb_wm_util_malloc0 (sizeof(void*) * N_CLASSES_PREALLOC);
       ObjectClassesInfo = mb_wm_util_malloc0 (
                                 sizeof(void*) * N_CLASSES_PREALLOC);
+      ObjectClassesStats = mb_wm_util_malloc0 (
+                  sizeof(MBWMObjectClassStats) * N_CLASSES_PREALLOC);
 
-      if (ObjectClasses && ObjectClassesInfo)
+      if (ObjectClasses && ObjectClassesInfo && ObjectClassesStats)
         ObjectClassesAllocated = N_CLASSES_PREALLOC;
     }
+
+#if MBWM_WANT_DEBUG
+  mb_wm_object_trace_init ();
+#endif
 }
 
 static void
@@ -134,14 +252,20 @@ mb_wm_object_register_class (MBWMObjectClassInfo *info,
       byte_len     = sizeof(void *) * (ObjectClassesAllocated);
       new_byte_len = sizeof(void *) * (ObjectClassesAllocated - new_offset);
 
-      ObjectClasses     = realloc (ObjectClasses,     byte_len);
-      ObjectClassesInfo = realloc (ObjectClassesInfo, byte_len);
+      ObjectClasses      = realloc (ObjectClasses,     byte_len);
+      ObjectClassesInfo  = realloc (ObjectClassesInfo, byte_len);
+      ObjectClassesStats = realloc (ObjectClassesStats,
+                                    sizeof(MBWMObjectClassStats) *
+                                    ObjectClassesAllocated);
 
-      if (!ObjectClasses || !ObjectClassesInfo)
+      if (!ObjectClasses || !ObjectClassesInfo || !ObjectClassesStats)
 	return 0;
 
       memset (ObjectClasses + new_offset    , 0, new_byte_len);
       memset (ObjectClassesInfo + new_offset, 0, new_byte_len);
+      memset (ObjectClassesStats + new_offset, 0,
+              sizeof(MBWMObjectClassStats) *
+              (ObjectClassesAllocated - new_offset));
     }
 
   ObjectClassesInfo[NObjectClasses] = info;
@@ -218,11 +342,14 @@ mb_wm_object_unref (MBWMObject *this)
       mb_wm_object_destroy_recursive (MB_WM_OBJECT_GET_CLASS (this),
 				      this);
 
-      free (this);
+      ObjectClassesStats[this->klass->type - 1].live--;
 
 #if MBWM_WANT_DEBUG
-      alloc_objects = mb_wm_util_list_remove (alloc_objects, this);
+      if (object_traces)
+        g_hash_table_remove (object_traces, this);
 #endif
+
+      free (this);
     }
 }
 
@@ -307,19 +434,61 @@ mb_wm_object_new (int type, ...)
 
   va_end(vap);
 
+  {
+    MBWMObjectClassStats *stats = &ObjectClassesStats[type-1];
+
+    stats->created++;
+    if (++stats->live > stats->peak)
+      stats->peak = stats->live;
+  }
+
 #if MBWM_WANT_DEBUG
- {
-   void * trace[MBWM_OBJECT_TRACE_DEPTH];
+  if (object_traces &&
+      (object_trace_sample == 1 ||
+       !g_random_int_range (0, object_trace_sample)))
+    {
+      MBWMObjectTrace *trace = g_new (MBWMObjectTrace, 1);
+
+      trace->type  = type;
+      trace->count = 0;
+      trace->depth = backtrace (trace->frames, MBWM_OBJECT_TRACE_DEPTH);
 
-   alloc_objects = mb_wm_util_list_append (alloc_objects, obj);
-   obj->trace_depth   = backtrace (trace, sizeof(trace)/sizeof(void*));
-   obj->trace_strings = backtrace_symbols (trace, obj->trace_depth);
- }
+      g_hash_table_insert (object_traces, obj, trace);
+    }
 #endif
 
   return obj;
 }
 
+int
+mb_wm_object_n_classes (void)
+{
+  return NObjectClasses;
+}
+
+/*
+ * Instance counts of a registered class; these are kept in all builds.
+ * The name is only known in debug builds, NULL otherwise.
+ */
+const MBWMObjectClassStats *
+mb_wm_object_class_stats (int type, size_t *instance_size, const char **name)
+{
+  if (type < 1 || type > NObjectClasses)
+    return NULL;
+
+  if (instance_size)
+    *instance_size = ObjectClassesInfo[type-1]->instance_size;
+
+  if (name)
+#if MBWM_WANT_DEBUG
+    *name = ObjectClasses[type-1]->klass_name;
+#else
+    *name = NULL;
+#endif
+
+  return &ObjectClassesStats[type-1];
+}
+
 unsigned long
 mb_wm_object_signal_connect (MBWMObject             *obj,
 			     unsigned long           signal,
@@ -370,7 +539,7 @@ mb_wm_object_signal_disconnect (MBWMObject    *obj,
 	  mb_wm_object_unref (MB_WM_OBJECT (info->data));
 
 	  free (info);
-	  free (item);
+	  mb_wm_util_list_free_item (item);
 
 	  return;
 	}
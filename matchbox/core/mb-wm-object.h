@@ -86,13 +86,19 @@ struct MBWMObject
   int              refcnt;
 
   MBWMList        *callbacks;
-
-#if MBWM_WANT_DEBUG
-  char           **trace_strings;
-  int              trace_depth;
-#endif
 };
 
+/**
+ * Instance counts of a class.
+ */
+typedef struct MBWMObjectClassStats
+{
+  unsigned long created;
+  unsigned long live;
+  unsigned long peak;
+}
+MBWMObjectClassStats;
+
 /* returns True to stop signal emission */
 typedef Bool (*MBWMObjectCallbackFunc) (MBWMObject *obj,
 					int         mask,
@@ -135,6 +141,12 @@ mb_wm_object_signal_emit (MBWMObject *obj, unsigned long signal);
 gboolean
 mb_wm_object_is_descendant (MBWMObject *obj, int type);
 
+int
+mb_wm_object_n_classes (void);
+
+const MBWMObjectClassStats *
+mb_wm_object_class_stats (int type, size_t *instance_size, const char **name);
+
 #if MBWM_WANT_DEBUG
 void
 mb_wm_object_dump ();
@@ -12,6 +12,8 @@ mb_wm_property_req (MBWindowManager *wm,
 {
   XasCookie cookie;
 
+  mb_wm_stats_property_fetch ();
+
   cookie = xas_get_property(wm->xas_context,
 			    win,
 			    property,
@@ -20,6 +22,9 @@ mb_wm_property_req (MBWindowManager *wm,
 			    delete,
 			    req_type);
 
+  if (UNLIKELY (mb_wm_record_on))
+    mb_wm_record_property_request (wm, (MBWMCookie)cookie, win, property);
+
   return (MBWMCookie)cookie;
 }
 
@@ -34,14 +39,28 @@ mb_wm_property_reply (MBWindowManager  *wm,
 		      unsigned char   **prop_return,
 		      int              *x_error_code)
 {
-  return  xas_get_property_reply(wm->xas_context,
-			         (XasCookie)cookie,
-				 actual_type_return,
-				 actual_format_return,
-				 nitems_return,
-				 bytes_after_return,
-				 prop_return,
-				 x_error_code);
+  Status status;
+
+  status = xas_get_property_reply(wm->xas_context,
+				  (XasCookie)cookie,
+				  actual_type_return,
+				  actual_format_return,
+				  nitems_return,
+				  bytes_after_return,
+				  prop_return,
+				  x_error_code);
+
+  if (UNLIKELY (mb_wm_record_on))
+    {
+      if (status)
+	mb_wm_record_property_reply (wm, cookie, *actual_type_return,
+				     *actual_format_return, *nitems_return,
+				     *prop_return);
+      else
+	mb_wm_record_property_reply (wm, cookie, None, 0, 0, NULL);
+    }
+
+  return status;
 }
 
 void*
@@ -70,6 +89,11 @@ mb_wm_property_get_reply_and_validate (MBWindowManager  *wm,
 			 &prop_data,
 			 x_error_code);
 
+  if (UNLIKELY (mb_wm_record_on))
+    mb_wm_record_property_reply (wm, cookie, actual_type_return,
+				 actual_format_return, nitems_return,
+				 *x_error_code ? NULL : prop_data);
+
   if (*x_error_code || prop_data == NULL)
     goto fail;
 
@@ -162,6 +186,159 @@ mb_wm_props_root_message (MBWindowManager *wm)
 
 
 
+}
+
+/*
+ * Write-through cache of the properties we set: a write of the value the
+ * property already has would only wake up everyone listening for
+ * PropertyNotify, so it is not sent at all.
+ *
+ * This is only good for properties nobody but us writes: most of the EWMH
+ * ones on the root window (not the desktop ones hildon-desktop also sets)
+ * and those the WM owns on the client windows (WM_STATE, _NET_WM_STATE,
+ * _NET_FRAME_EXTENTS).
+ */
+typedef struct MBWMPropCacheEntry
+{
+  Window        win;
+  Atom          property;
+  Atom          type;
+  int           format;
+  int           n_items;
+  size_t        size;
+  unsigned char data[];
+} MBWMPropCacheEntry;
+
+static guint
+mb_wm_prop_cache_hash (gconstpointer key)
+{
+  const MBWMPropCacheEntry *e = key;
+
+  return (guint) (e->win ^ (e->property << 16) ^ (e->property >> 16));
+}
+
+static gboolean
+mb_wm_prop_cache_equal (gconstpointer a, gconstpointer b)
+{
+  const MBWMPropCacheEntry *ea = a, *eb = b;
+
+  return ea->win == eb->win && ea->property == eb->property;
+}
+
+void
+mb_wm_property_change (MBWindowManager *wm,
+		       Window           win,
+		       Atom             property,
+		       Atom             type,
+		       int              format,
+		       const void      *data,
+		       int              n_items)
+{
+  MBWMPropCacheEntry  key, *e;
+  size_t              size;
+
+  /* Xlib keeps format 32 data in longs and 16 in shorts */
+  if (format == 32)
+    size = n_items * sizeof (long);
+  else if (format == 16)
+    size = n_items * sizeof (short);
+  else
+    size = n_items;
+
+  if (!wm->prop_cache)
+    wm->prop_cache = g_hash_table_new_full (mb_wm_prop_cache_hash,
+					    mb_wm_prop_cache_equal,
+					    NULL, free);
+
+  key.win      = win;
+  key.property = property;
+
+  e = g_hash_table_lookup (wm->prop_cache, &key);
+
+  if (e && e->type == type && e->format == format &&
+      e->n_items == n_items && e->size == size &&
+      (!size || !memcmp (e->data, data, size)))
+    {
+      wm->props_suppressed++;
+      return;
+    }
+
+  XChangeProperty (wm->xdpy, win, property, type, format, PropModeReplace,
+		   (unsigned char *) data, n_items);
+
+  e = mb_wm_util_malloc0 (sizeof (MBWMPropCacheEntry) + size);
+
+  e->win      = win;
+  e->property = property;
+  e->type     = type;
+  e->format   = format;
+  e->n_items  = n_items;
+  e->size     = size;
+
+  if (size)
+    memcpy (e->data, data, size);
+
+  g_hash_table_replace (wm->prop_cache, e, e);
+}
+
+void
+mb_wm_property_delete (MBWindowManager *wm,
+		       Window           win,
+		       Atom             property)
+{
+  MBWMPropCacheEntry key, *e = NULL;
+
+  key.win      = win;
+  key.property = property;
+
+  if (wm->prop_cache)
+    e = g_hash_table_lookup (wm->prop_cache, &key);
+
+  /* A deleted property is what we keep as type None */
+  if (e && e->type == None)
+    {
+      wm->props_suppressed++;
+      return;
+    }
+
+  XDeleteProperty (wm->xdpy, win, property);
+
+  if (!wm->prop_cache)
+    return;
+
+  e = mb_wm_util_malloc0 (sizeof (MBWMPropCacheEntry));
+
+  e->win      = win;
+  e->property = property;
+  e->type     = None;
+
+  g_hash_table_replace (wm->prop_cache, e, e);
+}
+
+static gboolean
+mb_wm_prop_cache_match_window (gpointer key, gpointer value, gpointer win)
+{
+  return ((MBWMPropCacheEntry *) key)->win == *(Window *) win;
+}
+
+/*
+ * Drops what we know of the properties of @win; must be called once we stop
+ * owning them, since a window id can be reused.
+ */
+void
+mb_wm_property_forget_window (MBWindowManager *wm,
+			      Window           win)
+{
+  if (wm->prop_cache)
+    g_hash_table_foreach_remove (wm->prop_cache,
+				 mb_wm_prop_cache_match_window, &win);
+}
+
+/* How many property writes the cache saved */
+unsigned long
+mb_wm_property_suppressed_count (MBWindowManager *wm)
+{
+  return wm->props_suppressed;
 }
 
 void
@@ -182,22 +359,30 @@ mb_wm_rename_window (MBWindowManager *wm,
 int
 mb_window_is_secondary (MBWindowManager *wm, Window w)
 {
-  Atom actual_type_return;
+  MBWMCookie cookie;
+  Atom actual_type_return = None;
   int actual_format_return;
   unsigned long nitems_return;
   unsigned long bytes_after_return;
   unsigned char* prop_return = NULL;
-
-  XGetWindowProperty (wm->xdpy, w,
-		      wm->atoms[MBWM_ATOM_MB_SECONDARY],
-		      0, 0,
-		      False,
-		      AnyPropertyType,
-		      &actual_type_return,
-		      &actual_format_return,
-		      &nitems_return,
-		      &bytes_after_return,
-		      &prop_return);
+  int x_error_code = 0;
+
+  /* Through the recorder, so replays see the same answer */
+  cookie = mb_wm_property_req (wm, w,
+			       wm->atoms[MBWM_ATOM_MB_SECONDARY],
+			       0, 0,
+			       False,
+			       AnyPropertyType);
+  mb_wm_util_sync (wm->xdpy, False);
+
+  if (!mb_wm_property_reply (wm, cookie,
+			     &actual_type_return,
+			     &actual_format_return,
+			     &nitems_return,
+			     &bytes_after_return,
+			     &prop_return,
+			     &x_error_code) || x_error_code)
+    actual_type_return = None;
 
   if (prop_return)
     XFree (prop_return);
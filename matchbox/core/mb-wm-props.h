@@ -111,6 +111,27 @@ mb_wm_rename_window (MBWindowManager *wm,
 		     Window win,
 		     const char *name);
 
+void
+mb_wm_property_change (MBWindowManager *wm,
+		       Window           win,
+		       Atom             property,
+		       Atom             type,
+		       int              format,
+		       const void      *data,
+		       int              n_items);
+
+void
+mb_wm_property_delete (MBWindowManager *wm,
+		       Window           win,
+		       Atom             property);
+
+void
+mb_wm_property_forget_window (MBWindowManager *wm,
+			      Window           win);
+
+unsigned long
+mb_wm_property_suppressed_count (MBWindowManager *wm);
+
 /**
  * Returns true iff the window is a sub-dialogue.
  * \bug this should be removed now; it's unnecessary
@@ -0,0 +1,231 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#include "mb-wm.h"
+#include "mb-wm-record.h"
+
+Bool mb_wm_record_on = False;
+
+static FILE       *record_file = NULL;
+static gint64      record_start;
+static GHashTable *record_atoms = NULL;
+
+static void
+mb_wm_record_write (MBWMRecordKind kind,
+		    const void    *head,
+		    size_t         head_len,
+		    const void    *data,
+		    size_t         data_len)
+{
+  MBWMRecord rec;
+
+  if (!record_file)
+    return;
+
+  memset (&rec, 0, sizeof (rec));
+  rec.kind = kind;
+  rec.len  = head_len + data_len;
+  rec.usec = g_get_monotonic_time () - record_start;
+
+  if (fwrite (&rec, sizeof (rec), 1, record_file) != 1 ||
+      (head_len && fwrite (head, head_len, 1, record_file) != 1) ||
+      (data_len && fwrite (data, data_len, 1, record_file) != 1))
+    {
+      g_warning ("Failed to write event record, recording stopped");
+      fclose (record_file);
+      record_file = NULL;
+      mb_wm_record_on = False;
+    }
+}
+
+/* Writes out the name of @atom the first time it is seen */
+static void
+mb_wm_record_atom (MBWindowManager *wm, Atom atom)
+{
+  guint32  id = atom;
+  char    *name;
+
+  if (atom == None ||
+      g_hash_table_lookup (record_atoms, GUINT_TO_POINTER (atom)))
+    return;
+
+  g_hash_table_insert (record_atoms, GUINT_TO_POINTER (atom),
+		       GUINT_TO_POINTER (1));
+
+  mb_wm_util_async_trap_x_errors (wm->xdpy);
+  name = XGetAtomName (wm->xdpy, atom);
+  mb_wm_util_async_untrap_x_errors ();
+
+  if (!name)
+    return;
+
+  mb_wm_record_write (MBWMRecordAtom, &id, sizeof (id), name, strlen (name));
+  XFree (name);
+}
+
+void
+mb_wm_record_init (MBWindowManager *wm)
+{
+  const char       *path = getenv ("MB_WM_RECORD");
+  MBWMRecordHeader  header;
+  int               i;
+
+  if (!path || record_file)
+    return;
+
+  if (!(record_file = fopen (path, "wb")))
+    {
+      g_warning ("Failed to open %s for recording", path);
+      return;
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, MBWM_RECORD_MAGIC, sizeof (header.magic));
+  header.root   = wm->root_win->xwindow;
+  header.width  = wm->xdpy_width;
+  header.height = wm->xdpy_height;
+
+  fwrite (&header, sizeof (header), 1, record_file);
+
+  record_start    = g_get_monotonic_time ();
+  record_atoms    = g_hash_table_new (NULL, NULL);
+  mb_wm_record_on = True;
+
+  /* The atoms we know about are what client messages carry as data */
+  for (i = 0; i < MBWM_ATOM_COUNT; i++)
+    mb_wm_record_atom (wm, wm->atoms[i]);
+
+  g_message ("Recording X events to %s", path);
+}
+
+void
+mb_wm_record_event (MBWindowManager *wm, XEvent *xev)
+{
+  XEvent               copy;
+  const unsigned char *bytes = (const unsigned char *) &copy;
+  size_t               len = sizeof (XEvent);
+
+  if (xev->type == PropertyNotify)
+    mb_wm_record_atom (wm, xev->xproperty.atom);
+  else if (xev->type == ClientMessage)
+    mb_wm_record_atom (wm, xev->xclient.message_type);
+
+  if (!mb_wm_record_on)
+    return;
+
+  /* The pointer means nothing in another process */
+  copy = *xev;
+  copy.xany.display = NULL;
+
+  while (len && !bytes[len - 1])
+    len--;
+
+  mb_wm_record_write (MBWMRecordEvent, NULL, 0, bytes, len);
+
+  /* One event's worth at a time, so a crash loses little */
+  if (record_file)
+    fflush (record_file);
+}
+
+void
+mb_wm_record_property_request (MBWindowManager *wm,
+			       MBWMCookie       cookie,
+			       Window           win,
+			       Atom             property)
+{
+  guint32 req[3];
+
+  mb_wm_record_atom (wm, property);
+
+  if (!mb_wm_record_on)
+    return;
+
+  req[0] = cookie;
+  req[1] = win;
+  req[2] = property;
+
+  mb_wm_record_write (MBWMRecordPropertyRequest, req, sizeof (req), NULL, 0);
+}
+
+void
+mb_wm_record_property_reply (MBWindowManager *wm,
+			     MBWMCookie       cookie,
+			     Atom             type,
+			     int              format,
+			     unsigned long    nitems,
+			     unsigned char   *data)
+{
+  guint32  reply[4];
+  guint32 *items = NULL;
+  size_t   len = 0;
+
+  if (!data)
+    type = None;
+
+  mb_wm_record_atom (wm, type);
+
+  if (!mb_wm_record_on)
+    return;
+
+  reply[0] = cookie;
+  reply[1] = type;
+  reply[2] = type != None ? format : 0;
+  reply[3] = type != None ? nitems : 0;
+
+  if (type != None)
+    {
+      if (format == 32)
+	{
+	  unsigned long i;
+
+	  /* Xlib hands format 32 data back as longs */
+	  items = g_new (guint32, nitems);
+	  for (i = 0; i < nitems; i++)
+	    items[i] = ((unsigned long *) data)[i];
+
+	  data = (unsigned char *) items;
+	  len  = nitems * 4;
+	}
+      else
+	len = nitems * (format / 8);
+    }
+
+  mb_wm_record_write (MBWMRecordPropertyReply, reply, sizeof (reply),
+		      data, len);
+  g_free (items);
+}
+
+/* A window that was already mapped when the window manager started */
+void
+mb_wm_record_adopt (MBWindowManager *wm,
+		    Window           xwin,
+		    MBGeometry      *geometry)
+{
+  guint32 adopt[5];
+
+  if (!mb_wm_record_on)
+    return;
+
+  adopt[0] = xwin;
+  adopt[1] = geometry->x;
+  adopt[2] = geometry->y;
+  adopt[3] = geometry->width;
+  adopt[4] = geometry->height;
+
+  mb_wm_record_write (MBWMRecordAdopt, adopt, sizeof (adopt), NULL, 0);
+}
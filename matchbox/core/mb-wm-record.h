@@ -0,0 +1,97 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#ifndef _HAVE_MB_WM_RECORD_H
+#define _HAVE_MB_WM_RECORD_H
+
+/*
+ * Event recorder, for replaying a session offline (see tests/mb-wm-replay).
+ * Set MB_WM_RECORD to a file name to record every X event dispatched, the
+ * contents of every property the window manager fetches and the windows it
+ * adopts at startup.
+ *
+ * The log is in host byte order: an MBWMRecordHeader followed by records,
+ * each an MBWMRecord followed by len bytes of payload:
+ *
+ *   Event             the XEvent, trailing zero bytes dropped
+ *   Atom              guint32 atom, then its name (not terminated)
+ *   PropertyRequest   guint32 cookie, window, property
+ *   PropertyReply     guint32 cookie, type, format, nitems, then the data
+ *                     with format 32 items stored as 32 bits
+ *   Adopt             guint32 window, then gint32 x, y, width, height
+ *
+ * The Display pointer of recorded events is cleared.
+ * Atoms are recorded before the first record that uses them.
+ */
+
+#define MBWM_RECORD_MAGIC "MBWMREC1"
+
+typedef enum MBWMRecordKind
+{
+  MBWMRecordEvent = 1,
+  MBWMRecordAtom,
+  MBWMRecordPropertyRequest,
+  MBWMRecordPropertyReply,
+  MBWMRecordAdopt,
+} MBWMRecordKind;
+
+typedef struct MBWMRecordHeader
+{
+  char    magic[8];
+  guint32 root;
+  guint32 width;
+  guint32 height;
+  guint32 pad;
+} MBWMRecordHeader;
+
+typedef struct MBWMRecord
+{
+  guint8  kind;
+  guint8  pad[3];
+  guint32 len;
+  gint64  usec;		/* since the start of the recording */
+} MBWMRecord;
+
+extern Bool mb_wm_record_on;
+
+void
+mb_wm_record_init (MBWindowManager *wm);
+
+void
+mb_wm_record_event (MBWindowManager *wm, XEvent *xev);
+
+void
+mb_wm_record_property_request (MBWindowManager *wm,
+			       MBWMCookie       cookie,
+			       Window           win,
+			       Atom             property);
+
+void
+mb_wm_record_property_reply (MBWindowManager *wm,
+			     MBWMCookie       cookie,
+			     Atom             type,
+			     int              format,
+			     unsigned long    nitems,
+			     unsigned char   *data);
+
+void
+mb_wm_record_adopt (MBWindowManager *wm,
+		    Window           xwin,
+		    MBGeometry      *geometry);
+
+#endif
@@ -147,6 +147,7 @@ mb_wm_root_window_init_attributes (MBWMRootWindow * win)
 {
   XSetWindowAttributes  sattr;
   MBWindowManager      *wm = win->wm;
+  MBWMXErrorTrap       *trap;
   int                   error;
 
   /* FIXME: We should check WM_S0 */
@@ -155,13 +156,12 @@ mb_wm_root_window_init_attributes (MBWMRootWindow * win)
                       |StructureNotifyMask
                       |PropertyChangeMask;
 
-  XSync(wm->xdpy, False);
-  mb_wm_util_trap_x_errors();
+  trap = mb_wm_util_deferred_trap_x_errors (wm->xdpy);
 
   XChangeWindowAttributes(wm->xdpy, win->xwindow, CWEventMask, &sattr);
 
-  XSync(wm->xdpy, False);
-  error = mb_wm_util_untrap_x_errors();
+  error = mb_wm_util_deferred_x_error (trap, True);
+  mb_wm_util_deferred_x_error_free (trap);
 
   if (error)
     {
@@ -328,9 +328,8 @@ mb_wm_root_window_init_properties (MBWMRootWindow * win)
 		  (unsigned char *)&card32, 1);
 #endif
 
-  XChangeProperty(wm->xdpy, rwin, wm->atoms[MBWM_ATOM_NET_SHOWING_DESKTOP],
-		  XA_CARDINAL, 32, PropModeReplace,
-		  (unsigned char *)&card32, 1);
+  mb_wm_property_change (wm, rwin, wm->atoms[MBWM_ATOM_NET_SHOWING_DESKTOP],
+			 XA_CARDINAL, 32, &card32, 1);
 
   val[0] = 0;
   val[1] = 0;
@@ -338,8 +337,6 @@ mb_wm_root_window_init_properties (MBWMRootWindow * win)
   XChangeProperty(wm->xdpy, rwin, wm->atoms[MBWM_ATOM_NET_DESKTOP_VIEWPORT],
 		  XA_CARDINAL, 32, PropModeReplace,
 		  (unsigned char *)&val[0], 2);
-
-  XSync(wm->xdpy, False);
 }
 
 int
@@ -470,6 +467,9 @@ mb_wm_root_window_handle_message (MBWMRootWindow *win, XClientMessageEvent *e)
 	     mb_wm_compositing_on (wm);
 	   return 1;
 #endif
+	 case MB_CMD_STATS:
+	   mb_wm_stats_publish (wm);
+	   return 1;
 	 default:
 	   /*FIXME -- not implemented yet */
 	 case MB_CMB_KEYS_RELOAD:
@@ -146,6 +146,60 @@ mb_wm_stack_ensure (MBWindowManager *wm)
 // mb_wm_stack_dump (wm, "FINISH");
 }
 
+/*
+ * Works out which part of each client can be seen, walking the stack from
+ * the top and taking away from the screen what every opaque client covers.
+ * Compositor effects (actor opacity, animations) are not taken into
+ * account, only the windows themselves.
+ */
+void
+mb_wm_stack_update_occlusion (MBWindowManager *wm)
+{
+  MBWindowManagerClient *client;
+  Region                 uncovered;
+  XRectangle             rect;
+
+  uncovered = XCreateRegion ();
+
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = wm->xdpy_width;
+  rect.height = wm->xdpy_height;
+  XUnionRectWithRegion (&rect, uncovered, uncovered);
+
+  mb_wm_stack_enumerate_reverse (wm, client)
+    {
+      Region visible = XCreateRegion ();
+
+      if (!XEmptyRegion (uncovered) && mb_wm_client_is_visible (client))
+	{
+	  MBGeometry geom;
+
+	  mb_wm_client_get_coverage (client, &geom);
+
+	  if (geom.width > 0 && geom.height > 0)
+	    {
+	      rect.x      = geom.x;
+	      rect.y      = geom.y;
+	      rect.width  = geom.width;
+	      rect.height = geom.height;
+
+	      XUnionRectWithRegion (&rect, visible, visible);
+	      XIntersectRegion (visible, uncovered, visible);
+
+	      if (mb_wm_client_is_opaque (client))
+		XSubtractRegion (uncovered, visible, uncovered);
+	    }
+	}
+
+      mb_wm_client_set_visible_region (client, visible);
+    }
+
+  XDestroyRegion (uncovered);
+
+  wm->occlusion_valid = True;
+}
+
 void
 mb_wm_stack_insert_above_client (MBWindowManagerClient *client,
 				 MBWindowManagerClient *client_below)
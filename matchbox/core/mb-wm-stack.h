@@ -52,6 +52,9 @@
 void
 mb_wm_stack_ensure (MBWindowManager *wm);
 
+void
+mb_wm_stack_update_occlusion (MBWindowManager *wm);
+
 void
 mb_wm_stack_insert_above_client (MBWindowManagerClient *client,
 				 MBWindowManagerClient *client_below);
@@ -0,0 +1,1105 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#include "mb-wm.h"
+#include "mb-wm-stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+
+/* Histograms have power of two buckets: <1us, <2us, <4us ... <8s, more */
+#define MBWM_STATS_BUCKETS     25
+
+/* X core event types fit in 7 bits; extension events share the rest */
+#define MBWM_STATS_EVENT_TYPES 128
+
+/* Deeper sections are folded into the innermost one that fits */
+#define MBWM_STATS_SECTION_DEPTH 16
+
+/*
+ * Latency probes: how many can be in flight, how many finished ones are
+ * listed window by window, how many are kept for the percentiles and how
+ * long one waits for its window to be shown before it is given up on.
+ */
+#define MBWM_STATS_PROBES_PENDING 16
+#define MBWM_STATS_PROBES_RECENT  32
+#define MBWM_STATS_PROBE_SAMPLES  256
+#define MBWM_STATS_PROBE_TIMEOUT  (10 * G_USEC_PER_SEC)
+
+typedef struct MBWMStatsHistogram
+{
+  unsigned long count;
+  gint64        total;
+  gint64        max;
+  unsigned long buckets[MBWM_STATS_BUCKETS];
+} MBWMStatsHistogram;
+
+typedef struct MBWMStatsCounter
+{
+  unsigned long count;
+  gint64        total;
+  gint64        max;
+  unsigned long requests;
+} MBWMStatsCounter;
+
+typedef struct MBWMStatsMemCounter
+{
+  unsigned long count;
+  gsize         bytes;
+  gsize         peak;
+} MBWMStatsMemCounter;
+
+/* X requests and round-trips caused by one named section of code */
+typedef struct MBWMStatsXAccount
+{
+  const char    *name;
+  unsigned long  sections;
+  unsigned long  requests;
+  unsigned long  round_trips;
+  gint64         blocked;
+  gint64         max_blocked;
+} MBWMStatsXAccount;
+
+/* One window on its way to the screen; xwin is None when the slot is free */
+typedef struct MBWMStatsProbe
+{
+  Window             xwin;
+  MBWMStatsProbeKind kind;
+  gint64             start;
+  gint64             handled;
+  gint64             synced;
+  gint64             shown;
+  char               name[32];
+} MBWMStatsProbe;
+
+/* The intervals a probe is broken into */
+typedef enum MBWMStatsProbeStage
+{
+  MBWMStatsProbeStageHandle = 0,  /* request to client managed / activated */
+  MBWMStatsProbeStageSync,        /* to the mb_wm_sync() that showed it */
+  MBWMStatsProbeStagePaint,       /* to the first composited frame */
+  MBWMStatsProbeStageTotal,
+
+  MBWMStatsProbeStageCount
+} MBWMStatsProbeStage;
+
+static const char *stats_phase_names[MBWMStatsPhaseCount] = {
+  "stack-ensure",
+  "layout",
+  "realize",
+  "display-sync",
+  "occlusion",
+  "comp-render",
+  "restack",
+  "comp-restack",
+};
+
+static const char *stats_mem_names[MBWMStatsMemCount] = {
+  "list nodes",
+  "theme pixmaps",
+  "comp textures",
+};
+
+static const char *stats_probe_names[MBWMStatsProbeCount] = {
+  "map",
+  "activate",
+};
+
+static const char *stats_probe_stage_names[MBWMStatsProbeStageCount] = {
+  "handle",
+  "sync",
+  "paint",
+  "total",
+};
+
+static const char *stats_event_names[] = {
+  "error",
+  "reply",
+  "KeyPress",
+  "KeyRelease",
+  "ButtonPress",
+  "ButtonRelease",
+  "MotionNotify",
+  "EnterNotify",
+  "LeaveNotify",
+  "FocusIn",
+  "FocusOut",
+  "KeymapNotify",
+  "Expose",
+  "GraphicsExpose",
+  "NoExpose",
+  "VisibilityNotify",
+  "CreateNotify",
+  "DestroyNotify",
+  "UnmapNotify",
+  "MapNotify",
+  "MapRequest",
+  "ReparentNotify",
+  "ConfigureNotify",
+  "ConfigureRequest",
+  "GravityNotify",
+  "ResizeRequest",
+  "CirculateNotify",
+  "CirculateRequest",
+  "PropertyNotify",
+  "SelectionClear",
+  "SelectionRequest",
+  "SelectionNotify",
+  "ColormapNotify",
+  "ClientMessage",
+  "MappingNotify",
+};
+
+static struct
+{
+  gint64             start;
+  unsigned long      start_request;
+  unsigned long      start_syncs;
+  unsigned long      property_fetches;
+
+  MBWMStatsCounter   events[MBWM_STATS_EVENT_TYPES];
+  MBWMStatsHistogram dispatch;
+
+  MBWMStatsHistogram sync;
+  MBWMStatsCounter   phases[MBWMStatsPhaseCount];
+
+  /* The mb_wm_sync() in progress */
+  gint64             sync_start;
+  int                phase;
+  gint64             phase_start;
+  unsigned long      phase_request;
+
+  MBWMStatsProbe     probes[MBWM_STATS_PROBES_PENDING];
+  unsigned long      probes_abandoned;
+
+  /* Finished probes, rings indexed by the running counts */
+  MBWMStatsProbe     recent[MBWM_STATS_PROBES_RECENT];
+  unsigned long      n_recent;
+  gint64             latency[MBWMStatsProbeCount][MBWMStatsProbeStageCount]
+			    [MBWM_STATS_PROBE_SAMPLES];
+  unsigned long      n_latency[MBWMStatsProbeCount];
+} stats;
+
+/*
+ * Kept apart from the counters above as it outlives mb_wm_stats_init(),
+ * which can run while a section is open.
+ */
+static struct
+{
+  GHashTable        *accounts;  /* name pointer -> MBWMStatsXAccount */
+  Display           *dpy;
+  MBWMStatsXAccount *stack[MBWM_STATS_SECTION_DEPTH];
+  int                depth;
+  unsigned long      mark;      /* first request not yet attributed */
+} x_acct;
+
+/* Not reset by mb_wm_stats_init(), these are live counts */
+static MBWMStatsMemCounter stats_mem[MBWMStatsMemCount];
+
+/* The SIGUSR1 dump, see mb_wm_stats_init() */
+static int               stats_pipe[2] = { -1, -1 };
+static struct sigaction  stats_old_action;
+static MBWindowManager  *stats_wm;
+static MBWMMainContext  *stats_watch_ctx;
+static unsigned long     stats_watch_id;
+
+/* Name of a core X event type, or NULL for extension events */
+const char *
+mb_wm_stats_event_name (int type)
+{
+  if (type < 0 || type >= (int) G_N_ELEMENTS (stats_event_names))
+    return NULL;
+
+  return stats_event_names[type];
+}
+
+static void
+mb_wm_stats_histogram_add (MBWMStatsHistogram *h, gint64 usec)
+{
+  int bucket = usec > 0 ? g_bit_storage (usec) : 0;
+
+  if (bucket >= MBWM_STATS_BUCKETS)
+    bucket = MBWM_STATS_BUCKETS - 1;
+
+  h->count++;
+  h->total += usec;
+  h->buckets[bucket]++;
+
+  if (usec > h->max)
+    h->max = usec;
+}
+
+static void
+mb_wm_stats_counter_add (MBWMStatsCounter *c, gint64 usec,
+			 unsigned long requests)
+{
+  c->count++;
+  c->total    += usec;
+  c->requests += requests;
+
+  if (usec > c->max)
+    c->max = usec;
+}
+
+void
+mb_wm_stats_event (MBWindowManager *wm,
+		   int              type,
+		   gint64           start,
+		   unsigned long    start_request)
+{
+  gint64 usec = g_get_monotonic_time () - start;
+
+  mb_wm_stats_counter_add (&stats.events[type & (MBWM_STATS_EVENT_TYPES - 1)],
+			   usec, NextRequest (wm->xdpy) - start_request);
+  mb_wm_stats_histogram_add (&stats.dispatch, usec);
+}
+
+static void
+mb_wm_stats_sync_phase_end (MBWindowManager *wm, gint64 now)
+{
+  if (stats.phase < 0)
+    return;
+
+  mb_wm_stats_counter_add (&stats.phases[stats.phase],
+			   now - stats.phase_start,
+			   NextRequest (wm->xdpy) - stats.phase_request);
+  mb_wm_stats_x_section_end ();
+  MBWM_SPAN_END (stats_phase_names[stats.phase]);
+  stats.phase = -1;
+}
+
+void
+mb_wm_stats_sync_begin (MBWindowManager *wm)
+{
+  MBWM_SPAN_BEGIN ("mb_wm_sync", NULL, None);
+  mb_wm_stats_x_section_begin (wm->xdpy, "mb_wm_sync");
+
+  stats.sync_start = g_get_monotonic_time ();
+  stats.phase      = -1;
+}
+
+/* Closes the current phase, if any, and starts timing the next one */
+void
+mb_wm_stats_sync_phase (MBWindowManager *wm, MBWMStatsPhase phase)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  mb_wm_stats_sync_phase_end (wm, now);
+
+  stats.phase         = phase;
+  stats.phase_start   = now;
+  stats.phase_request = NextRequest (wm->xdpy);
+
+  MBWM_SPAN_BEGIN (stats_phase_names[phase], NULL, None);
+  mb_wm_stats_x_section_begin (wm->xdpy, stats_phase_names[phase]);
+}
+
+static void
+mb_wm_stats_probe_finish (MBWMStatsProbe *probe)
+{
+  gint64        (*l)[MBWM_STATS_PROBE_SAMPLES] = stats.latency[probe->kind];
+  unsigned long i = stats.n_latency[probe->kind]++ % MBWM_STATS_PROBE_SAMPLES;
+
+  l[MBWMStatsProbeStageHandle][i] = probe->handled - probe->start;
+  l[MBWMStatsProbeStageSync][i]   = probe->synced - probe->handled;
+  l[MBWMStatsProbeStagePaint][i]  = probe->shown - probe->synced;
+  l[MBWMStatsProbeStageTotal][i]  = probe->shown - probe->start;
+
+  stats.recent[stats.n_recent++ % MBWM_STATS_PROBES_RECENT] = *probe;
+
+  probe->xwin = None;
+}
+
+/*
+ * Called from mb_wm_sync() once everything it had to do is done: windows
+ * that are now mapped, with their frames and decor, have been synced, and
+ * activations synced by the previous one have had their chance to paint.
+ */
+static void
+mb_wm_stats_probes_sync_end (MBWindowManager *wm, gint64 now)
+{
+  int i;
+
+  for (i = 0; i < MBWM_STATS_PROBES_PENDING; i++)
+    {
+      MBWMStatsProbe        *probe = &stats.probes[i];
+      MBWindowManagerClient *client;
+
+      if (probe->xwin == None)
+	continue;
+
+      /*
+       * Still not painted a whole sync later: activating a window that was
+       * already on show redraws nothing, so it was shown once synced.
+       */
+      if (probe->synced && probe->kind == MBWMStatsProbeActivate)
+	{
+	  probe->shown = probe->synced;
+	  mb_wm_stats_probe_finish (probe);
+	  continue;
+	}
+
+      if (now - probe->start > MBWM_STATS_PROBE_TIMEOUT)
+	{
+	  stats.probes_abandoned++;
+	  probe->xwin = None;
+	  continue;
+	}
+
+      if (probe->synced)
+	continue;
+
+      client = mb_wm_managed_client_from_xwindow (wm, probe->xwin);
+
+      if (!client)
+	{
+	  /* went away in the meantime */
+	  probe->xwin = None;
+	  continue;
+	}
+
+      if (!mb_wm_client_is_mapped (client))
+	continue;
+
+      probe->synced = now;
+
+      if (client->window->name)
+	g_strlcpy (probe->name, client->window->name, sizeof (probe->name));
+
+      if (!mb_wm_compositing_enabled (wm))
+	{
+	  probe->shown = now;
+	  mb_wm_stats_probe_finish (probe);
+	}
+    }
+}
+
+void
+mb_wm_stats_sync_end (MBWindowManager *wm)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  mb_wm_stats_sync_phase_end (wm, now);
+  mb_wm_stats_histogram_add (&stats.sync, now - stats.sync_start);
+
+  mb_wm_stats_probes_sync_end (wm, now);
+
+  mb_wm_stats_x_section_end ();
+  MBWM_SPAN_END ("mb_wm_sync");
+}
+
+/*
+ * Starts following xwin, for a request that came in at start and has just
+ * been dealt with.  Should the window already be followed, the probe that
+ * started first is kept, so an activation done while managing a new client
+ * counts towards its map.
+ */
+void
+mb_wm_stats_probe_handled (Window             xwin,
+			   MBWMStatsProbeKind kind,
+			   gint64             start)
+{
+  MBWMStatsProbe *probe = NULL;
+  int             i;
+
+  if (xwin == None)
+    return;
+
+  for (i = 0; i < MBWM_STATS_PROBES_PENDING; i++)
+    if (stats.probes[i].xwin == xwin)
+      {
+	probe = &stats.probes[i];
+
+	if (!probe->synced && probe->start <= start)
+	  return;
+
+	/* one still waiting to be painted is superseded */
+	if (probe->synced)
+	  stats.probes_abandoned++;
+
+	break;
+      }
+
+  /* a free slot, or else the oldest probe */
+  for (i = 0; !probe && i < MBWM_STATS_PROBES_PENDING; i++)
+    if (stats.probes[i].xwin == None)
+      probe = &stats.probes[i];
+
+  if (!probe)
+    {
+      probe = &stats.probes[0];
+
+      for (i = 1; i < MBWM_STATS_PROBES_PENDING; i++)
+	if (stats.probes[i].start < probe->start)
+	  probe = &stats.probes[i];
+
+      stats.probes_abandoned++;
+    }
+
+  memset (probe, 0, sizeof (*probe));
+  probe->xwin    = xwin;
+  probe->kind    = kind;
+  probe->start   = start;
+  probe->handled = g_get_monotonic_time ();
+}
+
+/* Probes synced and waiting for a frame; lets the compositor skip the rest */
+int
+mb_wm_stats_probes_waiting (void)
+{
+  int i, n = 0;
+
+  for (i = 0; i < MBWM_STATS_PROBES_PENDING; i++)
+    if (stats.probes[i].xwin != None && stats.probes[i].synced)
+      n++;
+
+  return n;
+}
+
+/* The compositor has painted a frame with client in it */
+void
+mb_wm_stats_probe_shown (MBWindowManagerClient *client)
+{
+  Window xwin = MB_WM_CLIENT_XWIN (client);
+  int    i;
+
+  for (i = 0; i < MBWM_STATS_PROBES_PENDING; i++)
+    {
+      MBWMStatsProbe *probe = &stats.probes[i];
+
+      if (probe->xwin == xwin && probe->synced)
+	{
+	  probe->shown = g_get_monotonic_time ();
+	  mb_wm_stats_probe_finish (probe);
+	  return;
+	}
+    }
+}
+
+void
+mb_wm_stats_property_fetch (void)
+{
+  stats.property_fetches++;
+}
+
+static MBWMStatsXAccount *
+mb_wm_stats_x_account (const char *name)
+{
+  MBWMStatsXAccount *account;
+
+  if (!x_acct.accounts)
+    x_acct.accounts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					     NULL, g_free);
+
+  account = g_hash_table_lookup (x_acct.accounts, name);
+
+  if (!account)
+    {
+      account = g_new0 (MBWMStatsXAccount, 1);
+      account->name = name;
+      g_hash_table_insert (x_acct.accounts, (gpointer) name, account);
+    }
+
+  return account;
+}
+
+static MBWMStatsXAccount *
+mb_wm_stats_x_innermost (void)
+{
+  if (!x_acct.depth)
+    return NULL;
+
+  return x_acct.stack[MIN (x_acct.depth, MBWM_STATS_SECTION_DEPTH) - 1];
+}
+
+/* Credits the requests issued since the last mark to the open section */
+static void
+mb_wm_stats_x_attribute (Display *dpy)
+{
+  MBWMStatsXAccount *account = mb_wm_stats_x_innermost ();
+  unsigned long      next = NextRequest (dpy);
+
+  if (account)
+    account->requests += next - x_acct.mark;
+
+  x_acct.mark = next;
+}
+
+/*
+ * Opens a section of code that X requests are attributed to, by serial
+ * range, until the matching mb_wm_stats_x_section_end(); sections nest and
+ * requests go to the innermost one.  name is not copied.
+ */
+void
+mb_wm_stats_x_section_begin (Display *dpy, const char *name)
+{
+  MBWMStatsXAccount *account = mb_wm_stats_x_account (name);
+
+  x_acct.dpy = dpy;
+  mb_wm_stats_x_attribute (dpy);
+
+  account->sections++;
+
+  if (x_acct.depth < MBWM_STATS_SECTION_DEPTH)
+    x_acct.stack[x_acct.depth] = account;
+
+  x_acct.depth++;
+}
+
+void
+mb_wm_stats_x_section_end (void)
+{
+  if (!x_acct.depth)
+    return;
+
+  mb_wm_stats_x_attribute (x_acct.dpy);
+  x_acct.depth--;
+}
+
+/*
+ * Accounts for a call that waited for the server since start, to the open
+ * section or, outside any, to function_name.
+ */
+void
+mb_wm_stats_round_trip_full (gint64 start, const char *function_name)
+{
+  MBWMStatsXAccount *account = mb_wm_stats_x_innermost ();
+  gint64             usec = g_get_monotonic_time () - start;
+
+  if (!account)
+    account = mb_wm_stats_x_account (function_name);
+
+  account->round_trips++;
+  account->blocked += usec;
+
+  if (usec > account->max_blocked)
+    account->max_blocked = usec;
+}
+
+void
+mb_wm_stats_mem_alloc (MBWMStatsMem kind, gsize bytes)
+{
+  MBWMStatsMemCounter *c = &stats_mem[kind];
+
+  c->count++;
+  c->bytes += bytes;
+
+  if (c->bytes > c->peak)
+    c->peak = c->bytes;
+}
+
+void
+mb_wm_stats_mem_free (MBWMStatsMem kind, gsize bytes)
+{
+  MBWMStatsMemCounter *c = &stats_mem[kind];
+
+  c->count--;
+  c->bytes -= bytes;
+}
+
+/* For memory that is cheaper to add up again than to track */
+void
+mb_wm_stats_mem_set (MBWMStatsMem kind, unsigned long count, gsize bytes)
+{
+  MBWMStatsMemCounter *c = &stats_mem[kind];
+
+  c->count = count;
+  c->bytes = bytes;
+
+  if (c->bytes > c->peak)
+    c->peak = c->bytes;
+}
+
+/* What the server is likely to allocate for a pixmap */
+gsize
+mb_wm_stats_pixmap_size (int width, int height, int depth)
+{
+  int bpp = depth > 16 ? 32 : depth > 8 ? 16 : depth > 1 ? 8 : 1;
+
+  if (width <= 0 || height <= 0)
+    return 0;
+
+  return (gsize) ((width * bpp + 31) / 32) * 4 * height;
+}
+
+static void
+mb_wm_stats_format_memory (GString *s)
+{
+  unsigned long objects = 0;
+  gsize         object_bytes = 0;
+  int           type, n = mb_wm_object_n_classes ();
+
+  g_string_append_printf (s, "\n%-24s %6s %8s %8s %10s %10s\n",
+			  "live objects", "size", "live", "peak",
+			  "created", "live bytes");
+
+  for (type = 1; type <= n; type++)
+    {
+      const MBWMObjectClassStats *c;
+      const char                 *name;
+      size_t                      size;
+      char                        buf[32];
+
+      c = mb_wm_object_class_stats (type, &size, &name);
+
+      if (!c || !c->created)
+	continue;
+
+      if (!name)
+	{
+	  g_snprintf (buf, sizeof (buf), "type %d", type);
+	  name = buf;
+	}
+
+      g_string_append_printf (s, "  %-22s %6lu %8lu %8lu %10lu %10lu\n",
+			      name, (unsigned long) size, c->live, c->peak,
+			      c->created, (unsigned long) (c->live * size));
+
+      objects      += c->live;
+      object_bytes += c->live * size;
+    }
+
+  g_string_append_printf (s, "  %-22s %6s %8lu %8s %10s %10lu\n",
+			  "total", "", objects, "", "",
+			  (unsigned long) object_bytes);
+
+  g_string_append_printf (s, "\n%-24s %8s %12s %12s\n",
+			  "memory", "count", "bytes", "peak bytes");
+
+  for (type = 0; type < MBWMStatsMemCount; type++)
+    g_string_append_printf (s, "  %-22s %8lu %12lu %12lu\n",
+			    stats_mem_names[type], stats_mem[type].count,
+			    (unsigned long) stats_mem[type].bytes,
+			    (unsigned long) stats_mem[type].peak);
+}
+
+static gint
+mb_wm_stats_x_account_compare (gconstpointer a, gconstpointer b)
+{
+  const MBWMStatsXAccount *x = *(MBWMStatsXAccount * const *) a;
+  const MBWMStatsXAccount *y = *(MBWMStatsXAccount * const *) b;
+
+  if (x->blocked != y->blocked)
+    return x->blocked < y->blocked ? 1 : -1;
+
+  if (x->requests != y->requests)
+    return x->requests < y->requests ? 1 : -1;
+
+  return strcmp (x->name, y->name);
+}
+
+static void
+mb_wm_stats_format_x_accounts (GString *s, unsigned long total)
+{
+  MBWMStatsXAccount **accounts;
+  GHashTableIter      iter;
+  gpointer            value;
+  unsigned long       attributed = 0;
+  int                 n = 0, i;
+
+  if (!x_acct.accounts)
+    return;
+
+  accounts = g_new (MBWMStatsXAccount *, g_hash_table_size (x_acct.accounts));
+
+  g_hash_table_iter_init (&iter, x_acct.accounts);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MBWMStatsXAccount *account = value;
+
+      if (account->requests || account->round_trips)
+	accounts[n++] = account;
+
+      attributed += account->requests;
+    }
+
+  qsort (accounts, n, sizeof (MBWMStatsXAccount *),
+	 mb_wm_stats_x_account_compare);
+
+  g_string_append_printf (s, "\n%-40s %8s %9s %11s %10s %8s\n",
+			  "X requests by section", "entered", "requests",
+			  "round-trips", "blocked ms", "max ms");
+
+  for (i = 0; i < n; i++)
+    g_string_append_printf (s, "  %-38s %8lu %9lu %11lu %10.3f %8.3f\n",
+			    accounts[i]->name, accounts[i]->sections,
+			    accounts[i]->requests, accounts[i]->round_trips,
+			    accounts[i]->blocked / 1000.0,
+			    accounts[i]->max_blocked / 1000.0);
+
+  if ((long) (total - attributed) > 0)
+    g_string_append_printf (s, "  %-38s %8s %9lu\n",
+			    "(outside any section)", "", total - attributed);
+
+  g_free (accounts);
+}
+
+static gint
+mb_wm_stats_compare_gint64 (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* Percentiles are over the last MBWM_STATS_PROBE_SAMPLES of each kind */
+static void
+mb_wm_stats_format_latency (GString *s)
+{
+  static const int pct[] = { 50, 90, 99 };
+  gint64           sorted[MBWM_STATS_PROBE_SAMPLES];
+  int              kind, stage, i;
+  unsigned long    n;
+
+  g_string_append_printf (s, "\n%-20s %8s %8s %8s %8s %8s\n",
+			  "latency", "count", "p50 ms", "p90 ms", "p99 ms",
+			  "max ms");
+
+  for (kind = 0; kind < MBWMStatsProbeCount; kind++)
+    {
+      n = MIN (stats.n_latency[kind], MBWM_STATS_PROBE_SAMPLES);
+
+      if (!n)
+	continue;
+
+      for (stage = 0; stage < MBWMStatsProbeStageCount; stage++)
+	{
+	  char name[32];
+
+	  memcpy (sorted, stats.latency[kind][stage], n * sizeof (gint64));
+	  qsort (sorted, n, sizeof (gint64), mb_wm_stats_compare_gint64);
+
+	  g_snprintf (name, sizeof (name), "%s %s", stats_probe_names[kind],
+		      stats_probe_stage_names[stage]);
+
+	  g_string_append_printf (s, "  %-18s %8lu", name,
+				  stats.n_latency[kind]);
+
+	  for (i = 0; i < (int) G_N_ELEMENTS (pct); i++)
+	    g_string_append_printf (s, " %8.3f",
+				    sorted[(n - 1) * pct[i] / 100] / 1000.0);
+
+	  g_string_append_printf (s, " %8.3f\n", sorted[n - 1] / 1000.0);
+	}
+    }
+
+  if (stats.probes_abandoned)
+    g_string_append_printf (s, "  %-18s %8lu\n", "abandoned",
+			    stats.probes_abandoned);
+
+  n = MIN (stats.n_recent, MBWM_STATS_PROBES_RECENT);
+
+  if (!n)
+    return;
+
+  g_string_append_printf (s, "\n%-12s %-24s %-8s %8s %8s %8s %8s\n",
+			  "latest", "name", "probe", "handle", "sync",
+			  "paint", "total ms");
+
+  for (i = 0; i < (int) n; i++)
+    {
+      const MBWMStatsProbe *p =
+	&stats.recent[(stats.n_recent - 1 - i) % MBWM_STATS_PROBES_RECENT];
+
+      g_string_append_printf (s, "  0x%08lx %-24s %-8s %8.3f %8.3f %8.3f "
+			      "%8.3f\n",
+			      p->xwin, p->name, stats_probe_names[p->kind],
+			      (p->handled - p->start) / 1000.0,
+			      (p->synced - p->handled) / 1000.0,
+			      (p->shown - p->synced) / 1000.0,
+			      (p->shown - p->start) / 1000.0);
+    }
+}
+
+static void
+mb_wm_stats_format_histogram (GString *s, const MBWMStatsHistogram *h)
+{
+  int i;
+
+  g_string_append_printf (s, "  count %lu, mean %.1f us, max %lld us\n ",
+			  h->count,
+			  h->count ? (double) h->total / h->count : 0.0,
+			  (long long) h->max);
+
+  for (i = 0; i < MBWM_STATS_BUCKETS; i++)
+    {
+      if (!h->buckets[i])
+	continue;
+
+      if (i == MBWM_STATS_BUCKETS - 1)
+	g_string_append_printf (s, " >=%luus:%lu",
+				1UL << (i - 1), h->buckets[i]);
+      else
+	g_string_append_printf (s, " <%luus:%lu", 1UL << i, h->buckets[i]);
+    }
+
+  g_string_append_c (s, '\n');
+}
+
+static void
+mb_wm_stats_format_counter (GString *s, const char *name,
+			    const MBWMStatsCounter *c)
+{
+  g_string_append_printf (s, "  %-18s %8lu %10.3f %8.3f %9lu\n",
+			  name, c->count, c->total / 1000.0,
+			  c->max / 1000.0, c->requests);
+}
+
+/* Returns the counters as text; free with g_free() */
+char *
+mb_wm_stats_format (MBWindowManager *wm)
+{
+  GString       *s = g_string_new (NULL);
+  unsigned long  requests = NextRequest (wm->xdpy) - stats.start_request;
+  int            i;
+
+  g_string_append_printf (s,
+			  "matchbox stats after %.3f s\n"
+			  "  X requests       %lu\n"
+			  "  XSyncs           %lu (%u in the last second)\n"
+			  "  property fetches %lu\n",
+			  (g_get_monotonic_time () - stats.start) / 1e6,
+			  requests,
+			  mb_wm_util_sync_count () - stats.start_syncs,
+			  mb_wm_util_sync_rate (),
+			  stats.property_fetches);
+
+  g_string_append_printf (s, "\n%-20s %8s %10s %8s %9s\n",
+			  "event", "count", "total ms", "max ms", "requests");
+
+  for (i = 0; i < MBWM_STATS_EVENT_TYPES; i++)
+    {
+      char name[32];
+
+      if (!stats.events[i].count)
+	continue;
+
+      if (mb_wm_stats_event_name (i))
+	g_strlcpy (name, mb_wm_stats_event_name (i), sizeof (name));
+      else
+	g_snprintf (name, sizeof (name), "extension-%d", i);
+
+      mb_wm_stats_format_counter (s, name, &stats.events[i]);
+    }
+
+  g_string_append (s, "\nevent dispatch\n");
+  mb_wm_stats_format_histogram (s, &stats.dispatch);
+
+  g_string_append (s, "\nmb_wm_sync\n");
+  mb_wm_stats_format_histogram (s, &stats.sync);
+
+  g_string_append_printf (s, "\n%-20s %8s %10s %8s %9s\n",
+			  "sync phase", "count", "total ms", "max ms",
+			  "requests");
+
+  for (i = 0; i < MBWMStatsPhaseCount; i++)
+    mb_wm_stats_format_counter (s, stats_phase_names[i], &stats.phases[i]);
+
+  mb_wm_stats_format_latency (s);
+  mb_wm_stats_format_x_accounts (s, requests);
+  mb_wm_stats_format_memory (s);
+
+  return g_string_free (s, FALSE);
+}
+
+/* Sets _MB_WM_STATS on the root window, read it with xprop -root */
+void
+mb_wm_stats_publish (MBWindowManager *wm)
+{
+  char *text = mb_wm_stats_format (wm);
+
+  XChangeProperty (wm->xdpy, wm->root_win->xwindow,
+		   wm->atoms[MBWM_ATOM_MB_WM_STATS],
+		   wm->atoms[MBWM_ATOM_UTF8_STRING], 8,
+		   PropModeReplace, (unsigned char *) text, strlen (text));
+  XFlush (wm->xdpy);
+
+  g_free (text);
+}
+
+Bool
+mb_wm_stats_dump (MBWindowManager *wm, const char *path)
+{
+  char   *text = mb_wm_stats_format (wm);
+  GError *error = NULL;
+  Bool    ret = True;
+
+  if (!g_file_set_contents (path, text, -1, &error))
+    {
+      g_warning ("Failed to write stats to %s: %s", path, error->message);
+      g_error_free (error);
+      ret = False;
+    }
+
+  g_free (text);
+
+  return ret;
+}
+
+/*
+ * SIGUSR1 only pokes the pipe; the dump is done from the main loop. Any
+ * handler that was installed before ours still gets the signal.
+ */
+static void
+mb_wm_stats_signal_handler (int sig, siginfo_t *info, void *context)
+{
+  int     saved_errno = errno;
+  char    c = 0;
+  ssize_t ignored;
+
+  /* A full pipe means a dump is pending already */
+  ignored = write (stats_pipe[1], &c, 1);
+  (void) ignored;
+
+  errno = saved_errno;
+
+  if (stats_old_action.sa_flags & SA_SIGINFO)
+    {
+      if (stats_old_action.sa_sigaction)
+	stats_old_action.sa_sigaction (sig, info, context);
+    }
+  else if (stats_old_action.sa_handler != SIG_DFL &&
+	   stats_old_action.sa_handler != SIG_IGN)
+    stats_old_action.sa_handler (sig);
+}
+
+static Bool
+mb_wm_stats_pipe_cb (MBWMIOChannel  *channel,
+		     MBWMIOCondition events,
+		     void           *userdata)
+{
+  MBWindowManager *wm = stats_wm;
+  const char      *path = getenv ("MB_WM_STATS_FILE");
+  char            *default_path = NULL;
+  char             buf[16];
+
+  while (read (stats_pipe[0], buf, sizeof (buf)) > 0)
+    ;
+
+  if (!path)
+    path = default_path = g_strdup_printf ("/tmp/matchbox-wm-stats.%d",
+					   (int) getpid ());
+
+  if (mb_wm_stats_dump (wm, path))
+    g_message ("Stats written to %s", path);
+
+  mb_wm_stats_publish (wm);
+
+  g_free (default_path);
+
+#if MBWM_WANT_DEBUG
+  /* Allocation sites of the live objects, to stderr */
+  mb_wm_object_dump ();
+#endif
+
+  if (mb_wm_trace_on)
+    {
+      path = getenv ("MB_WM_TRACE_FILE");
+      default_path = NULL;
+
+      if (!path)
+	path = default_path =
+	  g_strdup_printf ("/tmp/matchbox-wm-trace.%d.json", (int) getpid ());
+
+      if (mb_wm_trace_dump (path))
+	g_message ("Trace written to %s", path);
+
+      g_free (default_path);
+    }
+
+  return True;
+}
+
+void
+mb_wm_stats_init (MBWindowManager *wm)
+{
+  struct sigaction act;
+  int              i;
+
+  memset (&stats, 0, sizeof (stats));
+  stats.start         = g_get_monotonic_time ();
+  stats.start_request = NextRequest (wm->xdpy);
+  stats.start_syncs   = mb_wm_util_sync_count ();
+  stats.phase         = -1;
+
+  if (x_acct.accounts)
+    {
+      GHashTableIter iter;
+      gpointer       value;
+
+      g_hash_table_iter_init (&iter, x_acct.accounts);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+	{
+	  MBWMStatsXAccount *account = value;
+	  const char        *name = account->name;
+
+	  memset (account, 0, sizeof (*account));
+	  account->name = name;
+	}
+    }
+
+  x_acct.mark = NextRequest (wm->xdpy);
+
+  /* SIGUSR1 may well be used by the program, so it is only taken if asked */
+  if (!getenv ("MB_WM_STATS_SIGNAL"))
+    return;
+
+  stats_wm = wm;
+
+  if (stats_pipe[0] == -1)
+    {
+      if (pipe (stats_pipe) < 0)
+	return;
+
+      for (i = 0; i < 2; i++)
+	{
+	  fcntl (stats_pipe[i], F_SETFL, O_NONBLOCK);
+	  fcntl (stats_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+      memset (&act, 0, sizeof (act));
+      act.sa_sigaction = mb_wm_stats_signal_handler;
+      act.sa_flags     = SA_RESTART | SA_SIGINFO;
+      sigemptyset (&act.sa_mask);
+      sigaction (SIGUSR1, &act, &stats_old_action);
+    }
+
+  /* Dumps are done from the main loop of the latest window manager */
+  if (stats_watch_ctx == wm->main_ctx)
+    return;
+
+  if (stats_watch_ctx)
+    {
+      mb_wm_main_context_fd_watch_remove (stats_watch_ctx, stats_watch_id);
+      mb_wm_object_unref (MB_WM_OBJECT (stats_watch_ctx));
+    }
+
+  stats_watch_ctx = mb_wm_object_ref (MB_WM_OBJECT (wm->main_ctx));
+  stats_watch_id  =
+    mb_wm_main_context_fd_watch_add (wm->main_ctx,
+			mb_wm_main_context_io_channel_new (stats_pipe[0]),
+#if USE_GLIB_MAINLOOP
+			G_IO_IN,
+#else
+			POLLIN,
+#endif
+			mb_wm_stats_pipe_cb, NULL);
+}
@@ -0,0 +1,152 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#ifndef _HAVE_MB_WM_STATS_H
+#define _HAVE_MB_WM_STATS_H
+
+/*
+ * Always-on performance counters.  They are cheap enough to keep in
+ * release builds and can be read at runtime with
+ *
+ *   kill -USR1 <pid>      dumps to $MB_WM_STATS_FILE, or
+ *                         /tmp/matchbox-wm-stats.<pid>, and publishes them;
+ *                         only if MB_WM_STATS_SIGNAL is set at startup
+ *   MB_CMD_STATS          publishes them as the _MB_WM_STATS root property
+ *
+ * In debug builds SIGUSR1 also prints where the live objects were
+ * allocated, see mb_wm_object_dump().
+ */
+
+typedef enum MBWMStatsPhase
+{
+  MBWMStatsPhaseStackEnsure = 0,
+  MBWMStatsPhaseLayout,
+  MBWMStatsPhaseRealize,
+  MBWMStatsPhaseDisplaySync,
+  MBWMStatsPhaseOcclusion,
+  MBWMStatsPhaseCompRender,
+  MBWMStatsPhaseRestack,
+  MBWMStatsPhaseCompRestack,
+
+  MBWMStatsPhaseCount
+} MBWMStatsPhase;
+
+/* Memory we keep count of, besides the objects themselves */
+typedef enum MBWMStatsMem
+{
+  MBWMStatsMemListNodes = 0,
+  MBWMStatsMemThemePixmaps,
+  MBWMStatsMemTextures,
+
+  MBWMStatsMemCount
+} MBWMStatsMem;
+
+/* What started a latency probe */
+typedef enum MBWMStatsProbeKind
+{
+  MBWMStatsProbeMap = 0,       /* MapRequest of a new client */
+  MBWMStatsProbeActivate,      /* mb_wm_activate_client() */
+
+  MBWMStatsProbeCount
+} MBWMStatsProbeKind;
+
+void
+mb_wm_stats_init (MBWindowManager *wm);
+
+const char *
+mb_wm_stats_event_name (int type);
+
+void
+mb_wm_stats_event (MBWindowManager *wm,
+		   int              type,
+		   gint64           start,
+		   unsigned long    start_request);
+
+void
+mb_wm_stats_sync_begin (MBWindowManager *wm);
+
+void
+mb_wm_stats_sync_phase (MBWindowManager *wm, MBWMStatsPhase phase);
+
+void
+mb_wm_stats_sync_end (MBWindowManager *wm);
+
+void
+mb_wm_stats_property_fetch (void);
+
+/*
+ * X request accounting.  Requests are attributed by serial range to the
+ * innermost open section: the async error traps open one named after their
+ * caller, event dispatch one per event type and mb_wm_sync() one per phase.
+ * Calls that wait for the server are timed with mb_wm_stats_round_trip().
+ * Sections are keyed by the name pointer, which must be a static string.
+ */
+void
+mb_wm_stats_x_section_begin (Display *dpy, const char *name);
+
+void
+mb_wm_stats_x_section_end (void);
+
+void
+mb_wm_stats_round_trip_full (gint64 start, const char *function_name);
+
+#define mb_wm_stats_round_trip(START) \
+  mb_wm_stats_round_trip_full (START, __FUNCTION__)
+
+void
+mb_wm_stats_mem_alloc (MBWMStatsMem kind, gsize bytes);
+
+void
+mb_wm_stats_mem_free (MBWMStatsMem kind, gsize bytes);
+
+void
+mb_wm_stats_mem_set (MBWMStatsMem kind, unsigned long count, gsize bytes);
+
+gsize
+mb_wm_stats_pixmap_size (int width, int height, int depth);
+
+/*
+ * Latency probes follow a window from the request, through the
+ * mb_wm_sync() that maps its frame and paints its decor, to the first
+ * frame the compositor paints with it; without compositing they end with
+ * the sync.  An activation that has not caused a paint by the following
+ * sync is taken to have needed none.  mb_wm_stats_sync_end() moves them
+ * along.  start is when the request came in: for an X event, the
+ * event_start of the main context.
+ */
+void
+mb_wm_stats_probe_handled (Window             xwin,
+			   MBWMStatsProbeKind kind,
+			   gint64             start);
+
+int
+mb_wm_stats_probes_waiting (void);
+
+void
+mb_wm_stats_probe_shown (MBWindowManagerClient *client);
+
+char *
+mb_wm_stats_format (MBWindowManager *wm);
+
+void
+mb_wm_stats_publish (MBWindowManager *wm);
+
+Bool
+mb_wm_stats_dump (MBWindowManager *wm, const char *path);
+
+#endif
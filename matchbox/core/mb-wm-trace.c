@@ -0,0 +1,148 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#include "mb-wm.h"
+#include "mb-wm-trace.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#define MBWM_TRACE_DEFAULT_SIZE 65536
+
+typedef struct MBWMTraceEvent
+{
+  gint64         ts;
+  const char    *name;
+  const char    *detail;
+  unsigned long  xwin;
+  char           phase;
+} MBWMTraceEvent;
+
+Bool mb_wm_trace_on = False;
+
+static MBWMTraceEvent *trace_ring = NULL;
+static guint           trace_size = 0;
+static guint           trace_head = 0;
+static Bool            trace_wrapped = False;
+
+void
+mb_wm_trace_init (void)
+{
+  const char *env = getenv ("MB_WM_TRACE");
+  long        size;
+
+  if (!env || trace_ring)
+    return;
+
+  size = atol (env);
+  if (size <= 0)
+    size = MBWM_TRACE_DEFAULT_SIZE;
+
+  trace_ring = g_new0 (MBWMTraceEvent, size);
+  trace_size = size;
+  mb_wm_trace_on = True;
+}
+
+void
+mb_wm_trace_span (char           phase,
+		  const char    *name,
+		  const char    *detail,
+		  unsigned long  xwin)
+{
+  MBWMTraceEvent *ev = &trace_ring[trace_head];
+
+  ev->ts     = g_get_monotonic_time ();
+  ev->name   = name;
+  ev->detail = detail;
+  ev->xwin   = xwin;
+  ev->phase  = phase;
+
+  if (++trace_head == trace_size)
+    {
+      trace_head    = 0;
+      trace_wrapped = True;
+    }
+}
+
+/* Writes the ring, oldest span first, as trace-event JSON */
+Bool
+mb_wm_trace_dump (const char *path)
+{
+  FILE  *f;
+  guint  i, n, first;
+  int    depth = 0;
+  Bool   comma = False;
+  int    pid = getpid ();
+
+  if (!trace_ring)
+    return False;
+
+  if (!(f = fopen (path, "w")))
+    {
+      g_warning ("Failed to write trace to %s: %s", path, g_strerror (errno));
+      return False;
+    }
+
+  n     = trace_wrapped ? trace_size : trace_head;
+  first = trace_wrapped ? trace_head : 0;
+
+  fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  for (i = 0; i < n; i++)
+    {
+      MBWMTraceEvent *ev = &trace_ring[(first + i) % trace_size];
+
+      /* The start of spans cut off by the wrap-around is gone */
+      if (ev->phase == 'E')
+	{
+	  if (!depth)
+	    continue;
+	  depth--;
+	}
+      else
+	depth++;
+
+      fprintf (f, "%s{\"name\":\"%s\",\"cat\":\"mbwm\",\"ph\":\"%c\","
+	       "\"ts\":%lld,\"pid\":%d,\"tid\":%d",
+	       comma ? ",\n" : "", ev->name, ev->phase,
+	       (long long) ev->ts, pid, pid);
+
+      if (ev->phase == 'B' && (ev->detail || ev->xwin))
+	{
+	  fprintf (f, ",\"args\":{");
+	  if (ev->detail)
+	    fprintf (f, "\"detail\":\"%s\"%s", ev->detail, ev->xwin ? "," : "");
+	  if (ev->xwin)
+	    fprintf (f, "\"window\":\"0x%lx\"", ev->xwin);
+	  fprintf (f, "}");
+	}
+
+      fprintf (f, "}");
+      comma = True;
+    }
+
+  fprintf (f, "\n]}\n");
+
+  if (fclose (f) != 0)
+    {
+      g_warning ("Failed to write trace to %s: %s", path, g_strerror (errno));
+      return False;
+    }
+
+  return True;
+}
@@ -0,0 +1,55 @@
+/*
+ *  Matchbox Window Manager II - A lightweight window manager not for the
+ *                               desktop.
+ *
+ *  Copyright (c) 2005 OpenedHand Ltd - http://o-hand.com
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ */
+
+#ifndef _HAVE_MB_WM_TRACE_H
+#define _HAVE_MB_WM_TRACE_H
+
+/*
+ * Span tracing into a ring buffer, dumped as Chrome trace-event JSON (load
+ * it in chrome://tracing or Perfetto).  Enabled by setting MB_WM_TRACE to
+ * the ring size in events (any non-number gives the default); when it is
+ * off a span costs one predictable branch.  SIGUSR1 (see mb-wm-stats.h)
+ * dumps the ring to $MB_WM_TRACE_FILE, or /tmp/matchbox-wm-trace.<pid>.json.
+ *
+ * name and detail must be static strings.
+ */
+#define MBWM_SPAN_BEGIN(name, detail, xwin) do {			\
+    if (UNLIKELY (mb_wm_trace_on))					\
+      mb_wm_trace_span ('B', (name), (detail), (xwin));		\
+  } while (0)
+
+#define MBWM_SPAN_END(name) do {					\
+    if (UNLIKELY (mb_wm_trace_on))					\
+      mb_wm_trace_span ('E', (name), NULL, None);			\
+  } while (0)
+
+extern Bool mb_wm_trace_on;
+
+void
+mb_wm_trace_init (void);
+
+void
+mb_wm_trace_span (char           phase,
+		  const char    *name,
+		  const char    *detail,
+		  unsigned long  xwin);
+
+Bool
+mb_wm_trace_dump (const char *path);
+
+#endif
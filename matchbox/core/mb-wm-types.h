@@ -52,6 +52,7 @@ typedef struct MBGeometry
 } MBGeometry;
 
 typedef struct MBWMList MBWMList;
+typedef struct MBWMXErrorTrap MBWMXErrorTrap;
 
 typedef void (*MBWMListForEachCB) (void *data, void *userdata);
 
@@ -324,6 +325,9 @@ typedef enum MBWMAtom
   /* special Hildon property for "live background" windows */
   MBWM_ATOM_HILDON_LIVE_DESKTOP_BACKGROUND,
 
+  /* counters published on MB_CMD_STATS */
+  MBWM_ATOM_MB_WM_STATS,
+
   MBWM_ATOM_COUNT
 
 } MBWMAtom;
@@ -505,5 +509,6 @@ typedef enum MBWMModality
 #define MB_CMD_MISC        7 	/* spare, used for debugging */
 #define MB_CMD_COMPOSITE   8
 #define MB_CMB_KEYS_RELOAD 9
+#define MB_CMD_STATS       10	/* publish _MB_WM_STATS on the root */
 
 #endif
@@ -20,15 +20,71 @@ typedef struct {
 static GList *code_section_list = 0; /* of CodeSection */
 #endif
 
+/* Serial numbers wrap around, so compare them as a signed distance */
+#define SERIAL_LT(a, b) ((long)((a) - (b)) < 0)
+
+/**
+ * A deferred X error trap; see mb_wm_util_deferred_trap_x_errors().
+ */
+struct MBWMXErrorTrap
+{
+  Display       *display;
+  unsigned long  serial_start; /* serial of the first trapped request */
+  unsigned long  serial_end;   /* serial of the first request after the trap,
+                                  0 while the trap is still open */
+  int            error_code;   /* first error that hit the range */
+};
+
+static GList *deferred_trap_list = NULL; /* of MBWMXErrorTrap */
+static int (*chained_error_handler) (Display *, XErrorEvent *);
+
+static unsigned long sync_count       = 0;
+static unsigned int  sync_rate        = 0;
+static unsigned int  sync_this_second = 0;
+static gint64        sync_second      = 0;
+
 static int TrappedErrorCode = 0;
 static int (*old_error_handler) (Display *, XErrorEvent *);
 
+/* Records the error in any deferred trap whose range it falls into;
+ * returns True if there was one. */
+static Bool
+deferred_trap_claim (XErrorEvent *error)
+{
+  GList *entry;
+  Bool   claimed = False;
+
+  for (entry = deferred_trap_list; entry; entry = entry->next)
+    {
+      MBWMXErrorTrap *trap = entry->data;
+
+      if (trap->display == error->display &&
+          !SERIAL_LT (error->serial, trap->serial_start) &&
+          (!trap->serial_end || SERIAL_LT (error->serial, trap->serial_end)))
+        {
+          if (!trap->error_code)
+            trap->error_code = error->error_code;
+
+          claimed = True;
+        }
+    }
+
+  return claimed;
+}
+
 static int
 error_handler(Display     *xdpy,
 	      XErrorEvent *error)
 {
 #ifndef G_DEBUG_DISABLE
   char err[64], req[64];
+#endif
+
+  /* Synchronous traps are always preceded by an XSync, so the error is ours
+   * as well even if a deferred trap covers the same request. */
+  deferred_trap_claim (error);
+
+#ifndef G_DEBUG_DISABLE
 
   sprintf(err, "%s (%d)",
           error->error_code < G_N_ELEMENTS (mb_wm_debug_x_errors)
@@ -78,6 +134,13 @@ async_error_handler(Display     *xdpy,
   GList *entry;
   gchar error_string[256];
   CodeSection *blamed = 0;
+#endif
+
+  /* Whoever set up the deferred trap will deal with it */
+  if (deferred_trap_claim (error))
+    return 0;
+
+#ifndef G_DEBUG_DISABLE
 
   /* Find the section of code to blame */
   for (entry=code_section_list; entry; entry=entry->next)
@@ -173,7 +236,14 @@ mb_wm_util_async_trap_x_errors_full(Display *display,
                                     const gchar *message)
 {
 #ifndef G_DEBUG_DISABLE
-  CodeSection *section = g_malloc(sizeof(CodeSection));
+  CodeSection *section;
+#endif
+
+  /* The trap also tags the requests it covers for the stats */
+  mb_wm_stats_x_section_begin (display, function_name);
+
+#ifndef G_DEBUG_DISABLE
+  section = g_malloc(sizeof(CodeSection));
 
   /* This was purely paranoia */
   /*static int (*old_handler) (Display *, XErrorEvent *);
@@ -213,6 +283,11 @@ mb_wm_util_async_untrap_x_errors_full(const gchar *function_name)
 {
 #ifndef G_DEBUG_DISABLE
   CodeSection *section;
+#endif
+
+  mb_wm_stats_x_section_end ();
+
+#ifndef G_DEBUG_DISABLE
   if (!code_section_list)
     {
       g_warning("mb_wm_util_async_untrap_x_errors called from %s,"
@@ -233,6 +308,136 @@ mb_wm_util_async_untrap_x_errors_full(const gchar *function_name)
 #endif
 }
 
+/* Used when neither the async handler nor a synchronous trap is installed,
+ * so that deferred traps work regardless. */
+static int
+deferred_error_handler (Display     *xdpy,
+                        XErrorEvent *error)
+{
+  if (deferred_trap_claim (error))
+    return 0;
+
+  if (chained_error_handler)
+    return chained_error_handler (xdpy, error);
+
+  return 0;
+}
+
+/* Start a deferred trap: any X error caused by the requests issued until
+ * the matching mb_wm_util_deferred_untrap_x_errors() is swallowed and
+ * recorded in the returned trap. Unlike mb_wm_util_trap_x_errors() this
+ * does not need an XSync on either side, so several traps can be in
+ * flight at once and checked later with mb_wm_util_deferred_x_error(). */
+MBWMXErrorTrap*
+mb_wm_util_deferred_trap_x_errors (Display *display)
+{
+  MBWMXErrorTrap *trap = mb_wm_util_malloc0 (sizeof (MBWMXErrorTrap));
+  int (*handler) (Display *, XErrorEvent *);
+
+  handler = XSetErrorHandler (deferred_error_handler);
+
+  /* Both of these look at the deferred traps themselves */
+  if (handler == async_error_handler || handler == error_handler)
+    XSetErrorHandler (handler);
+  else if (handler != deferred_error_handler)
+    chained_error_handler = handler;
+
+  trap->display      = display;
+  trap->serial_start = NextRequest (display);
+
+  deferred_trap_list = g_list_prepend (deferred_trap_list, trap);
+
+  return trap;
+}
+
+void
+mb_wm_util_deferred_untrap_x_errors (MBWMXErrorTrap *trap)
+{
+  if (!trap->serial_end)
+    trap->serial_end = NextRequest (trap->display);
+}
+
+/* Returns the code of the first error that hit the trapped requests, or 0
+ * if there was none. If the server has not told us yet about all of them,
+ * the answer is not known: with @wait we do the round-trip, otherwise we
+ * return -1 and the caller should ask again later -- any reply or event
+ * read in the meantime (like the one for the XSync in mb_wm_sync()) may
+ * settle it. */
+int
+mb_wm_util_deferred_x_error (MBWMXErrorTrap *trap, Bool wait)
+{
+  mb_wm_util_deferred_untrap_x_errors (trap);
+
+  if (trap->error_code || trap->serial_end == trap->serial_start)
+    return trap->error_code;
+
+  if (SERIAL_LT (LastKnownRequestProcessed (trap->display),
+                 trap->serial_end - 1))
+    {
+      if (!wait)
+        return -1;
+
+      mb_wm_util_sync (trap->display, False);
+    }
+
+  return trap->error_code;
+}
+
+/* Errors in the range of the trap are no longer swallowed after this, so
+ * only free it once mb_wm_util_deferred_x_error() has given an answer. */
+void
+mb_wm_util_deferred_x_error_free (MBWMXErrorTrap *trap)
+{
+  if (!trap)
+    return;
+
+  deferred_trap_list = g_list_remove (deferred_trap_list, trap);
+  free (trap);
+}
+
+/* XSync() which keeps count of the round-trips we force on ourselves;
+ * use this rather than calling XSync() directly. */
+void
+mb_wm_util_sync_full (Display *display, Bool discard,
+                      const gchar *function_name)
+{
+  gint64 start = g_get_monotonic_time ();
+  gint64 now = start / G_USEC_PER_SEC;
+
+  if (now != sync_second)
+    {
+      sync_rate = (now == sync_second + 1) ? sync_this_second : 0;
+      sync_this_second = 0;
+      sync_second = now;
+    }
+
+  sync_count++;
+  sync_this_second++;
+
+  XSync (display, discard);
+
+  mb_wm_stats_round_trip_full (start, function_name);
+}
+
+/* Total number of XSyncs done through mb_wm_util_sync() */
+unsigned long
+mb_wm_util_sync_count (void)
+{
+  return sync_count;
+}
+
+/* Number of XSyncs done during the last full second */
+unsigned int
+mb_wm_util_sync_rate (void)
+{
+  gint64 now = g_get_monotonic_time () / G_USEC_PER_SEC;
+
+  if (now == sync_second)
+    return sync_rate;
+
+  return (now == sync_second + 1) ? sync_this_second : 0;
+}
+
 void*
 mb_wm_util_malloc0(int size)
 {
@@ -301,9 +506,20 @@ mb_wm_util_warn (const char *format, ...)
 MBWMList*
 mb_wm_util_list_alloc_item(void)
 {
+  mb_wm_stats_mem_alloc (MBWMStatsMemListNodes, sizeof(MBWMList));
+
   return mb_wm_util_malloc0(sizeof(MBWMList));
 }
 
+/* Frees a single node; its neighbours are left alone */
+void
+mb_wm_util_list_free_item(MBWMList *item)
+{
+  mb_wm_stats_mem_free (MBWMStatsMemListNodes, sizeof(MBWMList));
+
+  free(item);
+}
+
 int
 mb_wm_util_list_length(MBWMList *list)
 {
@@ -417,7 +633,7 @@ mb_wm_util_list_remove(MBWMList *list, void *data)
 	  else
 	    start = list->next;
 
-	  free(list);
+	  mb_wm_util_list_free_item(list);
 
 	  return start;
 	}
@@ -453,7 +669,7 @@ mb_wm_util_list_free (MBWMList * list)
       MBWMList * f = l;
       l = l->next;
 
-      free (f);
+      mb_wm_util_list_free_item (f);
     }
 }
 
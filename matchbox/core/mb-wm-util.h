@@ -90,6 +90,42 @@ mb_wm_util_async_untrap_x_errors_full(const gchar *function_name);
 
 #define mb_wm_util_async_untrap_x_errors() \
   mb_wm_util_async_untrap_x_errors_full(__FUNCTION__)
+
+/* XErrors - Deferred checking
+ *
+ * A deferred trap records the serial range of the requests issued between
+ * the trap and untrap calls; errors falling into that range are swallowed
+ * and remembered, so the caller can find out about them later without
+ * forcing a round-trip of its own.
+ */
+
+MBWMXErrorTrap*
+mb_wm_util_deferred_trap_x_errors (Display *display);
+
+void
+mb_wm_util_deferred_untrap_x_errors (MBWMXErrorTrap *trap);
+
+int
+mb_wm_util_deferred_x_error (MBWMXErrorTrap *trap, Bool wait);
+
+void
+mb_wm_util_deferred_x_error_free (MBWMXErrorTrap *trap);
+
+/* XSync accounting */
+
+void
+mb_wm_util_sync_full (Display *display, Bool discard,
+                      const gchar *function_name);
+
+#define mb_wm_util_sync(DISPLAY, DISCARD) \
+  mb_wm_util_sync_full(DISPLAY, DISCARD, __FUNCTION__)
+
+unsigned long
+mb_wm_util_sync_count (void);
+
+unsigned int
+mb_wm_util_sync_rate (void);
+
 /* List */
 
 
@@ -100,6 +136,9 @@ mb_wm_util_async_untrap_x_errors_full(const gchar *function_name);
 MBWMList*
 mb_wm_util_list_alloc_item(void);
 
+void
+mb_wm_util_list_free_item(MBWMList *item);
+
 MBWMList*
 mb_wm_util_list_remove(MBWMList *list, void *data);
 
@@ -27,6 +27,7 @@
 
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>          /* for XA_ATOM etc */
+#include <X11/Xutil.h>          /* Region */
 #include <X11/keysym.h>         /* key mask defines */
 
 #include <matchbox/mb-wm-config.h>
@@ -44,6 +45,7 @@
 #include <matchbox/core/mb-wm-debug.h>
 #include <matchbox/core/mb-wm-types.h>
 #include <matchbox/core/mb-wm-util.h>
+#include <matchbox/core/mb-wm-trace.h>
 #include <matchbox/core/mb-wm-object.h>
 #include <matchbox/core/mb-wm-atoms.h>
 #include <matchbox/core/mb-wm-props.h>
@@ -57,4 +59,6 @@
 #include <matchbox/core/mb-wm-stack.h>
 #include <matchbox/core/mb-window-manager.h>
 #include <matchbox/core/mb-wm-main-context.h>
+#include <matchbox/core/mb-wm-stats.h>
+#include <matchbox/core/mb-wm-record.h>
 #endif
@@ -79,6 +79,9 @@ mb_wm_theme_png_destroy (MBWMObject *obj)
 
   if (theme->shape_mask)
     XFreePixmap (dpy, theme->shape_mask);
+
+  if (theme->pixmap_bytes)
+    mb_wm_stats_mem_free (MBWMStatsMemThemePixmaps, theme->pixmap_bytes);
 }
 
 static int
@@ -147,6 +150,7 @@ struct DecorData
 {
   Pixmap    xpix;
   Pixmap    shape_mask;
+  gsize     pixmap_bytes;
   GC        gc_mask;
   XftDraw  *xftdraw;
   XftColor  clr;
@@ -168,6 +172,8 @@ decordata_free (MBWMDecor * decor, void *data)
   if (dd->shape_mask)
     XFreePixmap (xdpy, dd->shape_mask);
 
+  mb_wm_stats_mem_free (MBWMStatsMemThemePixmaps, dd->pixmap_bytes);
+
   if (dd->gc_mask)
     XFreeGC (xdpy, dd->gc_mask);
 
@@ -195,6 +201,7 @@ struct ButtonData
   /** Pixmap for the button's active state */
   Pixmap    xpix_a;
   XftDraw  *xftdraw_a;
+  gsize     pixmap_bytes;
 };
 
 static void
@@ -208,6 +215,8 @@ buttondata_free (MBWMDecorButton * button, void *data)
   XFreePixmap (xdpy, bd->xpix_a);
   XftDrawDestroy (bd->xftdraw_a);
 
+  mb_wm_stats_mem_free (MBWMStatsMemThemePixmaps, bd->pixmap_bytes);
+
   free (bd);
 }
 
@@ -295,6 +304,13 @@ mb_wm_theme_png_paint_button (MBWMTheme *theme, MBWMDecorButton *button)
 					    DefaultVisual (xdpy, xscreen),
 					    DefaultColormap (xdpy, xscreen));
 
+	  bdata->pixmap_bytes =
+	    2 * mb_wm_stats_pixmap_size (button->geom.width,
+					 button->geom.height,
+					 DefaultDepth (xdpy, xscreen));
+	  mb_wm_stats_mem_alloc (MBWMStatsMemThemePixmaps,
+				 bdata->pixmap_bytes);
+
 	  /*
 	   * If the background color is set for the parent decor, we do a fill
 	   * with the parent color first, then composite the decor image over,
@@ -386,7 +402,9 @@ mb_wm_theme_png_paint_button (MBWMTheme *theme, MBWMDecorButton *button)
       button->geom.height = b->height;
 
       XWindowAttributes attr;
+      gint64 start = g_get_monotonic_time ();
       XGetWindowAttributes( xdpy, decor->xwin, &attr );
+      mb_wm_stats_round_trip (start);
 
       /* We can't use PictOpOver because the target window
        * doesn't have an alpha channel
@@ -467,6 +485,9 @@ mb_wm_theme_png_paint_decor (MBWMTheme *theme, MBWMDecor *decor)
       data->xpix = XCreatePixmap(xdpy, decor->xwin,
 				 decor->geom.width, decor->geom.height,
 				 DefaultDepth(xdpy, xscreen));
+      data->pixmap_bytes =
+	mb_wm_stats_pixmap_size (decor->geom.width, decor->geom.height,
+				 DefaultDepth (xdpy, xscreen));
 
 
 #ifdef HAVE_XEXT
@@ -477,8 +498,11 @@ mb_wm_theme_png_paint_decor (MBWMTheme *theme, MBWMDecor *decor)
 			  decor->geom.width, decor->geom.height, 1);
 
 	  data->gc_mask = XCreateGC (xdpy, data->shape_mask, 0, NULL);
+	  data->pixmap_bytes +=
+	    mb_wm_stats_pixmap_size (decor->geom.width, decor->geom.height, 1);
 	}
 #endif
+      mb_wm_stats_mem_alloc (MBWMStatsMemThemePixmaps, data->pixmap_bytes);
       data->xftdraw = XftDrawCreate (xdpy, data->xpix,
 				     DefaultVisual (xdpy, xscreen),
 				     DefaultColormap (xdpy, xscreen));
@@ -1307,7 +1331,12 @@ mb_wm_theme_png_ximg (MBWMThemePng * theme, const char * img)
     theme->shape_mask =
       XCreatePixmap (dpy, RootWindow(dpy,screen), width, height, 1);
 
-  XSync (dpy, False);
+  theme->pixmap_bytes =
+    mb_wm_stats_pixmap_size (width, height, ren_fmt->depth) +
+    (shaped ? mb_wm_stats_pixmap_size (width, height, 1) : 0);
+  mb_wm_stats_mem_alloc (MBWMStatsMemThemePixmaps, theme->pixmap_bytes);
+
+  mb_wm_util_sync (dpy, False);
 
   ren_attr.dither          = True;
   ren_attr.component_alpha = True;
@@ -50,6 +50,7 @@ struct MBWMThemePng
   Pixmap           xdraw;
   Picture          xpic;
   Pixmap           shape_mask;
+  gsize            pixmap_bytes;  /* of xdraw and shape_mask */
 
 #if USE_PANGO
   PangoContext   * context;
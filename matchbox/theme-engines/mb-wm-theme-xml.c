@@ -66,7 +66,7 @@ mb_wm_xml_decor_free (MBWMXmlDecor * d)
       MBWMXmlButton * b = l->data;
       MBWMList * n = l->next;
       mb_wm_xml_button_free (b);
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
@@ -105,7 +105,7 @@ mb_wm_xml_client_free (MBWMXmlClient * c)
       MBWMXmlDecor * d = l->data;
       MBWMList * n = l->next;
       mb_wm_xml_decor_free (d);
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
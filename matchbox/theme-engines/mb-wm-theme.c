@@ -113,7 +113,7 @@ mb_wm_theme_destroy (MBWMObject *obj)
       MBWMXmlClient * c = l->data;
       MBWMList * n = l->next;
       mb_wm_xml_client_free (c);
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
@@ -348,7 +348,11 @@ mb_wm_theme_paint_decor (MBWMTheme *theme, MBWMDecor *decor)
   klass = MB_WM_THEME_CLASS(MB_WM_OBJECT_GET_CLASS (theme));
 
   if (klass->paint_decor)
-    klass->paint_decor (theme, decor);
+    {
+      MBWM_SPAN_BEGIN ("paint-decor", NULL, decor->xwin);
+      klass->paint_decor (theme, decor);
+      MBWM_SPAN_END ("paint-decor");
+    }
 }
 
 void
@@ -362,7 +366,11 @@ mb_wm_theme_paint_button (MBWMTheme *theme, MBWMDecorButton *button)
   klass = MB_WM_THEME_CLASS(MB_WM_OBJECT_GET_CLASS (theme));
 
   if (klass->paint_button)
-    klass->paint_button (theme, button);
+    {
+      MBWM_SPAN_BEGIN ("paint-button", NULL, button->decor->xwin);
+      klass->paint_button (theme, button);
+      MBWM_SPAN_END ("paint-button");
+    }
 }
 
 Bool
@@ -958,7 +966,7 @@ xml_stack_pop (MBWMList ** stack)
 
   *stack = top->next;
   free (s);
-  free (top);
+  mb_wm_util_list_free_item (top);
 }
 
 static void
@@ -969,7 +977,7 @@ xml_stack_free (MBWMList *stack)
     {
       MBWMList * n = l->next;
       free (l->data);
-      free (l);
+      mb_wm_util_list_free_item (l);
 
       l = n;
     }
@@ -1607,6 +1615,7 @@ construct_buttons (MBWMTheme * theme,
 struct DecorData
 {
   Pixmap            xpix;
+  gsize             pixmap_bytes;
   XftDraw          *xftdraw;
   XftColor          clr;
   XftFont          *font;
@@ -1619,6 +1628,7 @@ decordata_free (MBWMDecor * decor, void *data)
   Display * xdpy = decor->parent_client->wmref->xdpy;
 
   XFreePixmap (xdpy, dd->xpix);
+  mb_wm_stats_mem_free (MBWMStatsMemThemePixmaps, dd->pixmap_bytes);
 
   XftDrawDestroy (dd->xftdraw);
 
@@ -1990,6 +2000,10 @@ mb_wm_theme_simple_paint_decor (MBWMTheme *theme, MBWMDecor *decor)
       dd->xpix = XCreatePixmap(xdpy, xwin,
 			       decor->geom.width, decor->geom.height,
 			       DefaultDepth(xdpy, xscreen));
+      dd->pixmap_bytes =
+	mb_wm_stats_pixmap_size (decor->geom.width, decor->geom.height,
+				 DefaultDepth (xdpy, xscreen));
+      mb_wm_stats_mem_alloc (MBWMStatsMemThemePixmaps, dd->pixmap_bytes);
 
       dd->xftdraw = XftDrawCreate (xdpy, dd->xpix,
 				   DefaultVisual (xdpy, xscreen),
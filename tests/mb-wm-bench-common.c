@@ -0,0 +1,137 @@
+/*
+ * Shared by the headless benchmark programs.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mb-wm-bench-common.h"
+
+#include <time.h>
+
+/*
+ * A window manager without a compositing manager, so the benchmarks do not
+ * depend on a GL capable server.
+ */
+static void
+bench_wm_class_init (MBWMObjectClass *klass)
+{
+#if ENABLE_COMPOSITE
+  MBWindowManagerClass *wm_class = MB_WINDOW_MANAGER_CLASS (klass);
+
+  wm_class->comp_mgr_new = NULL;
+#endif
+
+#if MBWM_WANT_DEBUG
+  klass->klass_name = "BenchWm";
+#endif
+}
+
+static int
+bench_wm_class_type ()
+{
+  static int type = 0;
+
+  if (UNLIKELY(type == 0))
+    {
+      static MBWMObjectClassInfo info = {
+	sizeof (MBWindowManagerClass),
+	sizeof (MBWindowManager),
+	NULL,
+	NULL,
+	bench_wm_class_init
+      };
+
+      type = mb_wm_object_register_class (&info, MB_TYPE_WINDOW_MANAGER, 0);
+    }
+
+  return type;
+}
+
+/* Starts the window manager on $DISPLAY and lets it settle */
+MBWindowManager *
+bench_wm_new (const char *argv0, const char *theme)
+{
+  static char     *wm_argv[4];
+  int              wm_argc = 0;
+  MBWindowManager *wm;
+
+  wm_argv[wm_argc++] = (char *) argv0;
+  if (theme)
+    {
+      wm_argv[wm_argc++] = "-theme";
+      wm_argv[wm_argc++] = (char *) theme;
+    }
+  wm_argv[wm_argc] = NULL;
+
+  mb_wm_object_init ();
+
+  wm = MB_WINDOW_MANAGER (mb_wm_object_new (bench_wm_class_type (),
+					    MBWMObjectPropArgc, wm_argc,
+					    MBWMObjectPropArgv, wm_argv,
+					    NULL));
+  if (!wm)
+    return NULL;
+
+  mb_wm_init (wm);
+  bench_pump (wm);
+
+  return wm;
+}
+
+/*
+ * Let the window manager process everything the client has sent so far,
+ * the same way its own main loop would, until there is nothing left to do.
+ * The caller must have XSync()ed the client connection first.
+ */
+void
+bench_pump (MBWindowManager *wm)
+{
+  XEvent xev;
+
+  do
+    {
+      XSync (wm->xdpy, False);
+
+      while (XPending (wm->xdpy))
+	{
+	  XNextEvent (wm->xdpy, &xev);
+	  mb_wm_main_context_handle_x_event (&xev, wm->main_ctx);
+	}
+
+      if (wm->sync_type)
+	mb_wm_sync (wm);
+    }
+  while (XPending (wm->xdpy) || wm->sync_type);
+}
+
+double
+bench_now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int
+bench_compare_double (const void *a, const void *b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return (da > db) - (da < db);
+}
@@ -0,0 +1,37 @@
+/*
+ * Shared by the headless benchmark programs.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef _HAVE_MB_WM_BENCH_COMMON_H
+#define _HAVE_MB_WM_BENCH_COMMON_H
+
+#include <matchbox/core/mb-wm.h>
+
+MBWindowManager *
+bench_wm_new (const char *argv0, const char *theme);
+
+void
+bench_pump (MBWindowManager *wm);
+
+double
+bench_now_us (void);
+
+int
+bench_compare_double (const void *a, const void *b);
+
+#endif
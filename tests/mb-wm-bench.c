@@ -0,0 +1,452 @@
+/*
+ * Headless benchmark for libmatchbox2.
+ *
+ * Runs the window manager in-process on one display connection and drives
+ * it from a second, plain Xlib, connection acting as the client.  Meant to
+ * be run against Xvfb (see run-bench.sh); results are written as JSON.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mb-wm-bench-common.h"
+
+#define BENCH_MAX_WINDOWS 200
+
+/* How long the window manager gets to react before the run is failed */
+#define BENCH_WAIT_TIMEOUT_US 5e6
+
+static const int bench_sync_sizes[] = { 1, 10, 50, 100, 200 };
+
+typedef struct Bench
+{
+  MBWindowManager *wm;
+  Display         *dpy;      /* the client connection */
+  FILE            *out;
+  int              iterations;
+  const char      *theme;
+  const char      *alt_theme;
+  Bool             first_result;
+
+  Atom             net_active_window;
+  Atom             net_wm_name;
+  Atom             net_wm_window_type;
+  Atom             net_wm_window_type_dialog;
+  Atom             utf8_string;
+} Bench;
+
+/*
+ * Writes one result object; samples are sorted in place.  extra_key may be
+ * NULL, otherwise it is emitted as an integer parameter of the result.
+ */
+static void
+bench_report (Bench *b, const char *name, const char *extra_key,
+	      int extra_val, double *samples, int n)
+{
+  double sum = 0.0;
+  int    i;
+
+  qsort (samples, n, sizeof (double), bench_compare_double);
+
+  for (i = 0; i < n; ++i)
+    sum += samples[i];
+
+  fprintf (b->out, "%s\n    { \"name\": \"%s\"", b->first_result ? "" : ",",
+	   name);
+
+  if (extra_key)
+    fprintf (b->out, ", \"%s\": %d", extra_key, extra_val);
+
+  fprintf (b->out,
+	   ", \"unit\": \"us\", \"samples\": %d, \"min\": %.1f, "
+	   "\"median\": %.1f, \"p95\": %.1f, \"max\": %.1f, \"mean\": %.1f }",
+	   n, samples[0], samples[n / 2], samples[(n * 95) / 100],
+	   samples[n - 1], sum / n);
+
+  b->first_result = False;
+}
+
+static void
+bench_report_rate (Bench *b, const char *name, int events, double elapsed)
+{
+  fprintf (b->out, "%s\n    { \"name\": \"%s\", \"unit\": \"events/s\", "
+	   "\"events\": %d, \"elapsed_us\": %.1f, \"rate\": %.1f }",
+	   b->first_result ? "" : ",", name, events, elapsed,
+	   events / (elapsed / 1e6));
+
+  b->first_result = False;
+}
+
+static Window
+bench_create_window (Bench *b, Window transient_for)
+{
+  Window win;
+
+  win = XCreateSimpleWindow (b->dpy, DefaultRootWindow (b->dpy),
+			     0, 0, 200, 200, 0, 0, 0);
+
+  XStoreName (b->dpy, win, "mb-wm-bench");
+
+  if (transient_for != None)
+    {
+      XSetTransientForHint (b->dpy, win, transient_for);
+      XChangeProperty (b->dpy, win, b->net_wm_window_type, XA_ATOM, 32,
+		       PropModeReplace,
+		       (unsigned char *) &b->net_wm_window_type_dialog, 1);
+    }
+
+  return win;
+}
+
+/*
+ * Gives up on the whole run if the window manager has not done what we are
+ * waiting for in time; the results would be meaningless anyway.
+ */
+static void
+bench_check_deadline (double start, const char *what, Window win)
+{
+  if (bench_now_us () - start < BENCH_WAIT_TIMEOUT_US)
+    return;
+
+  fprintf (stderr, "mb-wm-bench: timed out waiting for window %lx to be %s\n",
+	   win, what);
+  exit (1);
+}
+
+/*
+ * Maps the window and pumps the window manager until it has a client for it.
+ * Returns the latency in microseconds.
+ */
+static double
+bench_map_and_wait (Bench *b, Window win)
+{
+  double start = bench_now_us ();
+
+  XMapWindow (b->dpy, win);
+  XSync (b->dpy, False);
+
+  bench_pump (b->wm);
+
+  while (!mb_wm_managed_client_from_xwindow (b->wm, win))
+    {
+      bench_check_deadline (start, "managed", win);
+      bench_pump (b->wm);
+    }
+
+  return bench_now_us () - start;
+}
+
+static double
+bench_destroy_and_wait (Bench *b, Window win)
+{
+  double start = bench_now_us ();
+
+  XDestroyWindow (b->dpy, win);
+  XSync (b->dpy, False);
+
+  bench_pump (b->wm);
+
+  while (mb_wm_managed_client_from_xwindow (b->wm, win))
+    {
+      bench_check_deadline (start, "unmanaged", win);
+      bench_pump (b->wm);
+    }
+
+  return bench_now_us () - start;
+}
+
+static void
+bench_map_to_managed (Bench *b)
+{
+  double *samples = malloc (b->iterations * sizeof (double));
+  int     i;
+
+  for (i = 0; i < b->iterations; ++i)
+    {
+      Window win = bench_create_window (b, None);
+
+      samples[i] = bench_map_and_wait (b, win);
+      bench_destroy_and_wait (b, win);
+    }
+
+  bench_report (b, "map_to_managed", NULL, 0, samples, b->iterations);
+  free (samples);
+}
+
+/*
+ * Cost of a full mb_wm_sync() pass, including the server round trip, with
+ * n managed windows.
+ */
+static void
+bench_sync (Bench *b, int n)
+{
+  double *samples = malloc (b->iterations * sizeof (double));
+  int     i;
+
+  for (i = 0; i < b->iterations; ++i)
+    {
+      double start;
+
+      mb_wm_display_sync_queue (b->wm, MBWMSyncStacking  |
+				       MBWMSyncGeometry  |
+				       MBWMSyncVisibility);
+
+      start = bench_now_us ();
+
+      mb_wm_sync (b->wm);
+      XSync (b->wm->xdpy, False);
+
+      samples[i] = bench_now_us () - start;
+    }
+
+  bench_report (b, "sync", "windows", n, samples, b->iterations);
+  free (samples);
+}
+
+/*
+ * Activates a window further down the stack through _NET_ACTIVE_WINDOW, the
+ * way a task switcher would, and waits for the window manager to restack.
+ */
+static void
+bench_restack (Bench *b, Window *wins, int n)
+{
+  double *samples = malloc (b->iterations * sizeof (double));
+  int     i;
+
+  for (i = 0; i < b->iterations; ++i)
+    {
+      XEvent ev;
+      double start;
+
+      memset (&ev, 0, sizeof (ev));
+      ev.xclient.type         = ClientMessage;
+      ev.xclient.window       = wins[i % n];
+      ev.xclient.message_type = b->net_active_window;
+      ev.xclient.format       = 32;
+      ev.xclient.data.l[0]    = 2; /* pager */
+
+      start = bench_now_us ();
+
+      XSendEvent (b->dpy, DefaultRootWindow (b->dpy), False,
+		  SubstructureRedirectMask | SubstructureNotifyMask, &ev);
+      XSync (b->dpy, False);
+
+      bench_pump (b->wm);
+
+      samples[i] = bench_now_us () - start;
+    }
+
+  bench_report (b, "restack", "windows", n, samples, b->iterations);
+  free (samples);
+}
+
+static void
+bench_property_notify (Bench *b, Window win)
+{
+  int    events = b->iterations * 100;
+  char   name[32];
+  double start;
+  int    i;
+
+  start = bench_now_us ();
+
+  for (i = 0; i < events; ++i)
+    {
+      snprintf (name, sizeof (name), "mb-wm-bench %d", i);
+
+      XChangeProperty (b->dpy, win, b->net_wm_name, b->utf8_string, 8,
+		       PropModeReplace, (unsigned char *) name, strlen (name));
+    }
+
+  XSync (b->dpy, False);
+  bench_pump (b->wm);
+
+  bench_report_rate (b, "property_notify", events, bench_now_us () - start);
+}
+
+static void
+bench_dialog_churn (Bench *b, Window parent)
+{
+  double *samples = malloc (b->iterations * sizeof (double));
+  int     i;
+
+  for (i = 0; i < b->iterations; ++i)
+    {
+      Window dialog = bench_create_window (b, parent);
+
+      samples[i]  = bench_map_and_wait (b, dialog);
+      samples[i] += bench_destroy_and_wait (b, dialog);
+    }
+
+  bench_report (b, "dialog_open_close", NULL, 0, samples, b->iterations);
+  free (samples);
+}
+
+static void
+bench_theme_switch (Bench *b, int n)
+{
+  double *samples;
+  int     i;
+
+  if (!b->theme || !b->alt_theme)
+    return;
+
+  samples = malloc (b->iterations * sizeof (double));
+
+  for (i = 0; i < b->iterations; ++i)
+    {
+      double start = bench_now_us ();
+
+      mb_wm_set_theme_from_path (b->wm, (i & 1) ? b->theme : b->alt_theme);
+      bench_pump (b->wm);
+
+      samples[i] = bench_now_us () - start;
+    }
+
+  bench_report (b, "theme_switch", "windows", n, samples, b->iterations);
+  free (samples);
+}
+
+static void
+bench_usage (const char *name)
+{
+  fprintf (stderr,
+	   "Usage: %s [-o FILE] [-n ITERATIONS] [-theme DIR] [-alt-theme DIR]\n"
+	   "       %s -serve [-theme DIR]\n"
+	   "\n"
+	   "Must be run on an otherwise unmanaged display, e.g. Xvfb.  With\n"
+	   "-serve, just runs the window manager, for mb-wm-storm.\n",
+	   name,
+	   name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  Bench   b;
+  Window  wins[BENCH_MAX_WINDOWS];
+  Bool    serve = False;
+  int     n = 0;
+  int     i, j;
+
+  memset (&b, 0, sizeof (b));
+  b.out          = stdout;
+  b.iterations   = 50;
+  b.first_result = True;
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (!strcmp (argv[i], "-serve"))
+	{
+	  serve = True;
+	  continue;
+	}
+
+      if (i == argc - 1)
+	bench_usage (argv[0]);
+
+      if (!strcmp (argv[i], "-o"))
+	{
+	  if (!(b.out = fopen (argv[++i], "w")))
+	    {
+	      perror (argv[i]);
+	      return 1;
+	    }
+	}
+      else if (!strcmp (argv[i], "-n"))
+	b.iterations = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-theme"))
+	b.theme = argv[++i];
+      else if (!strcmp (argv[i], "-alt-theme"))
+	b.alt_theme = argv[++i];
+      else
+	bench_usage (argv[0]);
+    }
+
+  if (b.iterations < 1)
+    bench_usage (argv[0]);
+
+  if (serve)
+    {
+      if (!(b.wm = bench_wm_new (argv[0], b.theme)))
+	{
+	  fprintf (stderr, "%s: failed to create window manager\n", argv[0]);
+	  return 1;
+	}
+
+      mb_wm_main_loop (b.wm);
+      return 0;
+    }
+
+  if (!(b.dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "%s: cannot open display\n", argv[0]);
+      return 1;
+    }
+
+  b.net_active_window  = XInternAtom (b.dpy, "_NET_ACTIVE_WINDOW", False);
+  b.net_wm_name        = XInternAtom (b.dpy, "_NET_WM_NAME", False);
+  b.net_wm_window_type = XInternAtom (b.dpy, "_NET_WM_WINDOW_TYPE", False);
+  b.net_wm_window_type_dialog =
+    XInternAtom (b.dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
+  b.utf8_string        = XInternAtom (b.dpy, "UTF8_STRING", False);
+
+  if (!(b.wm = bench_wm_new (argv[0], b.theme)))
+    {
+      fprintf (stderr, "%s: failed to create window manager\n", argv[0]);
+      return 1;
+    }
+
+  fprintf (b.out, "{\n  \"suite\": \"mb-wm-bench\",\n"
+	   "  \"iterations\": %d,\n  \"screen\": \"%dx%d\",\n  \"results\": [",
+	   b.iterations, b.wm->xdpy_width, b.wm->xdpy_height);
+
+  bench_map_to_managed (&b);
+
+  for (j = 0; j < (int) (sizeof (bench_sync_sizes) / sizeof (int)); ++j)
+    {
+      while (n < bench_sync_sizes[j])
+	{
+	  wins[n] = bench_create_window (&b, None);
+	  bench_map_and_wait (&b, wins[n]);
+	  n++;
+	}
+
+      bench_sync (&b, n);
+      bench_restack (&b, wins, n);
+    }
+
+  bench_property_notify (&b, wins[0]);
+  bench_dialog_churn (&b, wins[0]);
+
+  while (n > 10)
+    bench_destroy_and_wait (&b, wins[--n]);
+
+  bench_theme_switch (&b, n);
+
+  fprintf (b.out, "\n  ]\n}\n");
+
+  if (b.out != stdout)
+    fclose (b.out);
+
+  while (n > 0)
+    bench_destroy_and_wait (&b, wins[--n]);
+
+  mb_wm_object_unref (MB_WM_OBJECT (b.wm));
+  XCloseDisplay (b.dpy);
+
+  return 0;
+}
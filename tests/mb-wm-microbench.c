@@ -0,0 +1,651 @@
+/*
+ * Microbenchmarks for the core data structures of libmatchbox2.
+ *
+ * Needs no X server: the window manager and its clients are put together
+ * by hand and never touch a display, so only the stacking, layout, list
+ * and object code is timed.  Results are written as JSON, in ns/op.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mb-wm-bench-common.h"
+
+/* Operations timed per round, at least; small cases are repeated */
+#define MICRO_MIN_OPS 1000
+
+static const int micro_sizes[] = { 10, 100, 1000 };
+
+typedef struct Micro
+{
+  MBWindowManager        *wm;
+  MBWindowManagerClient **clients;
+  int                     n_clients;
+  FILE                   *out;
+  int                     rounds;
+  Bool                    first_result;
+} Micro;
+
+/*
+ * The clients are of the override type, so that mb_wm_client_stack()
+ * doesn't mark them dirty, which would need the private part of the
+ * client.  Every other one is a "filler" without a stack method, which
+ * mb_wm_stack_cycle_by_type() has to skip and mb_wm_stack_ensure() walks
+ * past without moving.
+ */
+#define MICRO_CLIENT_TYPE MBWMClientTypeOverride
+#define MICRO_FILLER_TYPE MBWMClientTypeApp
+
+static void
+micro_client_move_to_top_recursive (MBWindowManagerClient *client)
+{
+  MBWMList *l;
+
+  mb_wm_stack_move_top (client);
+
+  for (l = client->transients; l; l = mb_wm_util_list_next (l))
+    micro_client_move_to_top_recursive (l->data);
+}
+
+/* Same as the stack method of MBWMClientBase, which is private */
+static void
+micro_client_stack (MBWindowManagerClient *client, int flags)
+{
+  while (client->transient_for)
+    client = client->transient_for;
+
+  micro_client_move_to_top_recursive (client);
+}
+
+static int
+micro_client_init (MBWMObject *obj, va_list vap)
+{
+  MBWindowManagerClient *client = MB_WM_CLIENT (obj);
+  MBWMObjectProp         prop;
+
+  prop = va_arg (vap, MBWMObjectProp);
+  while (prop)
+    {
+      if (prop == MBWMObjectPropWm)
+	client->wmref = va_arg (vap, MBWindowManager *);
+      else
+	MBWMO_PROP_EAT (vap, prop);
+
+      prop = va_arg (vap, MBWMObjectProp);
+    }
+
+  client->window = mb_wm_util_malloc0 (sizeof (MBWMClientWindow));
+  client->window->geometry.width  = 200;
+  client->window->geometry.height = 200;
+
+  return 1;
+}
+
+static void
+micro_client_destroy (MBWMObject *obj)
+{
+  MBWindowManagerClient *client = MB_WM_CLIENT (obj);
+
+  mb_wm_util_list_free (client->transients);
+  free (client->window);
+}
+
+static void
+micro_client_class_init (MBWMObjectClass *klass)
+{
+  MBWindowManagerClientClass *client = MB_WM_CLIENT_CLASS (klass);
+
+  client->client_type = MICRO_CLIENT_TYPE;
+  client->stack       = micro_client_stack;
+
+#if MBWM_WANT_DEBUG
+  klass->klass_name = "MicroClient";
+#endif
+}
+
+static void
+micro_filler_class_init (MBWMObjectClass *klass)
+{
+  MBWindowManagerClientClass *client = MB_WM_CLIENT_CLASS (klass);
+
+  client->client_type = MICRO_FILLER_TYPE;
+
+#if MBWM_WANT_DEBUG
+  klass->klass_name = "MicroFiller";
+#endif
+}
+
+static int
+micro_client_class_type ()
+{
+  static int type = 0;
+
+  if (UNLIKELY(type == 0))
+    {
+      static MBWMObjectClassInfo info = {
+	sizeof (MBWindowManagerClientClass),
+	sizeof (MBWindowManagerClient),
+	micro_client_init,
+	micro_client_destroy,
+	micro_client_class_init
+      };
+
+      type = mb_wm_object_register_class (&info, 0, 0);
+    }
+
+  return type;
+}
+
+static int
+micro_filler_class_type ()
+{
+  static int type = 0;
+
+  if (UNLIKELY(type == 0))
+    {
+      static MBWMObjectClassInfo info = {
+	sizeof (MBWindowManagerClientClass),
+	sizeof (MBWindowManagerClient),
+	micro_client_init,
+	micro_client_destroy,
+	micro_filler_class_init
+      };
+
+      type = mb_wm_object_register_class (&info, 0, 0);
+    }
+
+  return type;
+}
+
+/*
+ * Makes n clients, not yet stacked: the odd ones are fillers, every fourth
+ * is transient for the client before it and the rest are spread over the
+ * layers from panels up.
+ */
+static void
+micro_clients_new (Micro *m, int n)
+{
+  int i;
+
+  m->clients   = malloc (n * sizeof (MBWindowManagerClient *));
+  m->n_clients = n;
+
+  for (i = 0; i < n; ++i)
+    {
+      MBWindowManagerClient *client;
+      int                    type;
+
+      type = (i & 1) ? micro_filler_class_type () : micro_client_class_type ();
+
+      client = MB_WM_CLIENT (mb_wm_object_new (type,
+					       MBWMObjectPropWm, m->wm,
+					       NULL));
+
+      if (i % 4 == 2)
+	{
+	  client->transient_for = m->clients[i - 2];
+	  client->transient_for->transients =
+	    mb_wm_util_list_append (client->transient_for->transients, client);
+	}
+      else
+	client->stacking_layer = MBWMStackLayerBottomMid + (i % 4);
+
+      m->clients[i] = client;
+    }
+}
+
+static void
+micro_clients_free (Micro *m)
+{
+  int i;
+
+  for (i = 0; i < m->n_clients; ++i)
+    mb_wm_object_unref (MB_WM_OBJECT (m->clients[i]));
+
+  free (m->clients);
+  m->clients   = NULL;
+  m->n_clients = 0;
+}
+
+/* Stacks all the clients, each above a random one already in the stack */
+static void
+micro_stack_fill (Micro *m)
+{
+  int i;
+
+  for (i = 0; i < m->n_clients; ++i)
+    mb_wm_stack_insert_above_client (m->clients[i],
+				     i ? m->clients[rand () % i] : NULL);
+}
+
+static void
+micro_stack_clear (Micro *m)
+{
+  while (m->wm->stack_top)
+    mb_wm_stack_remove (m->wm->stack_top);
+}
+
+/* Writes one result; per_op holds one ns/op figure per round, sorted here */
+static void
+micro_report (Micro *m, const char *name, int n, long ops, double *per_op)
+{
+  qsort (per_op, m->rounds, sizeof (double), bench_compare_double);
+
+  fprintf (m->out, "%s\n    { \"name\": \"%s\"", m->first_result ? "" : ",",
+	   name);
+
+  if (n)
+    fprintf (m->out, ", \"clients\": %d", n);
+
+  fprintf (m->out,
+	   ", \"unit\": \"ns/op\", \"rounds\": %d, \"ops\": %ld, "
+	   "\"min\": %.1f, \"median\": %.1f, \"max\": %.1f }",
+	   m->rounds, ops, per_op[0], per_op[m->rounds / 2],
+	   per_op[m->rounds - 1]);
+
+  m->first_result = False;
+}
+
+static int
+micro_repeats (int n)
+{
+  return n < MICRO_MIN_OPS ? MICRO_MIN_OPS / n : 1;
+}
+
+/*
+ * Builds the stack as micro_stack_fill() does and takes it down again,
+ * in an order unrelated to the stacking; 7 is coprime with all the sizes.
+ */
+static void
+micro_stack_insert_remove (Micro *m)
+{
+  int     n = m->n_clients;
+  int     repeats = micro_repeats (n);
+  double *insert = malloc (m->rounds * sizeof (double));
+  double *removal = malloc (m->rounds * sizeof (double));
+  int    *below = malloc (n * sizeof (int));
+  int     r, i, j;
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double insert_us = 0.0, remove_us = 0.0, start;
+
+      for (j = 0; j < repeats; ++j)
+	{
+	  for (i = 1; i < n; ++i)
+	    below[i] = rand () % i;
+
+	  start = bench_now_us ();
+	  mb_wm_stack_insert_above_client (m->clients[0], NULL);
+	  for (i = 1; i < n; ++i)
+	    mb_wm_stack_insert_above_client (m->clients[i],
+					     m->clients[below[i]]);
+	  insert_us += bench_now_us () - start;
+
+	  start = bench_now_us ();
+	  for (i = 0; i < n; ++i)
+	    mb_wm_stack_remove (m->clients[(i * 7) % n]);
+	  remove_us += bench_now_us () - start;
+	}
+
+      insert[r] = insert_us * 1e3 / (n * repeats);
+      removal[r] = remove_us * 1e3 / (n * repeats);
+    }
+
+  micro_report (m, "stack_insert_above_client", n, (long) n * repeats, insert);
+  micro_report (m, "stack_remove", n, (long) n * repeats, removal);
+
+  free (below);
+  free (insert);
+  free (removal);
+}
+
+static void
+micro_stack_move (Micro *m)
+{
+  int     n = m->n_clients;
+  int     ops = MAX (n, MICRO_MIN_OPS);
+  double *per_op = malloc (m->rounds * sizeof (double));
+  int    *pairs = malloc (2 * ops * sizeof (int));
+  int     r, i;
+
+  micro_stack_fill (m);
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double start;
+
+      for (i = 0; i < 2 * ops; ++i)
+	pairs[i] = rand () % n;
+
+      start = bench_now_us ();
+
+      for (i = 0; i < ops; ++i)
+	mb_wm_stack_move_above_client (m->clients[pairs[2 * i]],
+				       m->clients[pairs[2 * i + 1]]);
+
+      per_op[r] = (bench_now_us () - start) * 1e3 / ops;
+    }
+
+  micro_stack_clear (m);
+
+  micro_report (m, "stack_move_above_client", n, ops, per_op);
+
+  free (pairs);
+  free (per_op);
+}
+
+/*
+ * One mb_wm_stack_ensure() per round, after shuffling a tenth of the stack
+ * so that it has some work to do.
+ */
+static void
+micro_stack_ensure (Micro *m)
+{
+  int     n = m->n_clients;
+  int     repeats = micro_repeats (n * 10);
+  double *per_op = malloc (m->rounds * sizeof (double));
+  int     r, i, j;
+
+  micro_stack_fill (m);
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double elapsed = 0.0, start;
+
+      for (j = 0; j < repeats; ++j)
+	{
+	  for (i = 0; i <= n / 10; ++i)
+	    mb_wm_stack_move_above_client (m->clients[rand () % n],
+					   m->clients[rand () % n]);
+
+	  start = bench_now_us ();
+	  mb_wm_stack_ensure (m->wm);
+	  elapsed += bench_now_us () - start;
+	}
+
+      per_op[r] = elapsed * 1e3 / repeats;
+    }
+
+  micro_stack_clear (m);
+
+  micro_report (m, "stack_ensure", n, repeats, per_op);
+
+  free (per_op);
+}
+
+static void
+micro_stack_cycle (Micro *m)
+{
+  int     n = m->n_clients;
+  int     ops = MAX (n, MICRO_MIN_OPS);
+  double *forward = malloc (m->rounds * sizeof (double));
+  double *reverse = malloc (m->rounds * sizeof (double));
+  int     r, i;
+
+  micro_stack_fill (m);
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double start;
+
+      start = bench_now_us ();
+      for (i = 0; i < ops; ++i)
+	mb_wm_stack_cycle_by_type (m->wm, MICRO_CLIENT_TYPE, False);
+      forward[r] = (bench_now_us () - start) * 1e3 / ops;
+
+      start = bench_now_us ();
+      for (i = 0; i < ops; ++i)
+	mb_wm_stack_cycle_by_type (m->wm, MICRO_CLIENT_TYPE, True);
+      reverse[r] = (bench_now_us () - start) * 1e3 / ops;
+    }
+
+  micro_stack_clear (m);
+
+  micro_report (m, "stack_cycle_by_type", n, ops, forward);
+  micro_report (m, "stack_cycle_by_type_reverse", n, ops, reverse);
+
+  free (forward);
+  free (reverse);
+}
+
+/*
+ * The list is as long as the stack, as for the transients of a client;
+ * it is emptied in the same order the stack is in
+ * micro_stack_insert_remove().
+ */
+static void
+micro_list (Micro *m)
+{
+  int       n = m->n_clients;
+  int       repeats = micro_repeats (n);
+  double   *append = malloc (m->rounds * sizeof (double));
+  double   *length = malloc (m->rounds * sizeof (double));
+  double   *removal = malloc (m->rounds * sizeof (double));
+  MBWMList *list = NULL;
+  int       r, i, j, total = 0;
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double append_us = 0.0, length_us = 0.0, remove_us = 0.0, start;
+
+      for (j = 0; j < repeats; ++j)
+	{
+	  start = bench_now_us ();
+	  for (i = 0; i < n; ++i)
+	    list = mb_wm_util_list_append (list, m->clients[i]);
+	  append_us += bench_now_us () - start;
+
+	  start = bench_now_us ();
+	  total += mb_wm_util_list_length (list);
+	  length_us += bench_now_us () - start;
+
+	  start = bench_now_us ();
+	  for (i = 0; i < n; ++i)
+	    list = mb_wm_util_list_remove (list, m->clients[(i * 7) % n]);
+	  remove_us += bench_now_us () - start;
+
+	  MBWM_ASSERT (list == NULL);
+	}
+
+      append[r] = append_us * 1e3 / (n * repeats);
+      length[r] = length_us * 1e3 / repeats;
+      removal[r] = remove_us * 1e3 / (n * repeats);
+    }
+
+  if (total != n * repeats * m->rounds)
+    fprintf (stderr, "list: bad length %d\n", total);
+
+  micro_report (m, "list_append", n, (long) n * repeats, append);
+  micro_report (m, "list_length", n, repeats, length);
+  micro_report (m, "list_remove", n, (long) n * repeats, removal);
+
+  free (append);
+  free (length);
+  free (removal);
+}
+
+/*
+ * The layout helpers don't depend on the number of clients; they are fed
+ * a spread of geometries, some inside the available area, some not.
+ */
+static void
+micro_layout (Micro *m)
+{
+  double     *clip = malloc (m->rounds * sizeof (double));
+  double     *maximise = malloc (m->rounds * sizeof (double));
+  MBGeometry  avail = { 0, 56, 800, 424 };
+  MBGeometry *geoms = malloc (MICRO_MIN_OPS * sizeof (MBGeometry));
+  MBGeometry *work = malloc (MICRO_MIN_OPS * sizeof (MBGeometry));
+  int         r, i, changed = 0;
+
+  for (i = 0; i < MICRO_MIN_OPS; ++i)
+    {
+      geoms[i].x      = rand () % 1000 - 100;
+      geoms[i].y      = rand () % 600 - 100;
+      geoms[i].width  = rand () % 900 + 1;
+      geoms[i].height = rand () % 500 + 1;
+    }
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double start;
+
+      memcpy (work, geoms, MICRO_MIN_OPS * sizeof (MBGeometry));
+
+      start = bench_now_us ();
+      for (i = 0; i < MICRO_MIN_OPS; ++i)
+	changed += mb_wm_layout_clip_geometry (&work[i], &avail, SET_ALL);
+      clip[r] = (bench_now_us () - start) * 1e3 / MICRO_MIN_OPS;
+
+      memcpy (work, geoms, MICRO_MIN_OPS * sizeof (MBGeometry));
+
+      start = bench_now_us ();
+      for (i = 0; i < MICRO_MIN_OPS; ++i)
+	changed += mb_wm_layout_maximise_geometry (&work[i], &avail, SET_ALL);
+      maximise[r] = (bench_now_us () - start) * 1e3 / MICRO_MIN_OPS;
+    }
+
+  /* keeps the calls from being optimised away */
+  if (!changed)
+    fprintf (stderr, "layout: no geometry needed changing\n");
+
+  micro_report (m, "layout_clip_geometry", 0, MICRO_MIN_OPS, clip);
+  micro_report (m, "layout_maximise_geometry", 0, MICRO_MIN_OPS, maximise);
+
+  free (geoms);
+  free (work);
+  free (clip);
+  free (maximise);
+}
+
+/*
+ * mb_wm_object_new() and the final mb_wm_object_unref() of a client; in
+ * debug builds this includes the allocation backtraces, see
+ * MB_WM_OBJECT_TRACE_SAMPLE.
+ */
+static void
+micro_object (Micro *m)
+{
+  double     *per_op = malloc (m->rounds * sizeof (double));
+  MBWMObject *objs[MICRO_MIN_OPS];
+  int         type = micro_client_class_type ();
+  int         r, i;
+
+  for (r = 0; r < m->rounds; ++r)
+    {
+      double start = bench_now_us ();
+
+      for (i = 0; i < MICRO_MIN_OPS; ++i)
+	objs[i] = mb_wm_object_new (type, MBWMObjectPropWm, m->wm, NULL);
+
+      for (i = 0; i < MICRO_MIN_OPS; ++i)
+	mb_wm_object_unref (objs[i]);
+
+      per_op[r] = (bench_now_us () - start) * 1e3 / MICRO_MIN_OPS;
+    }
+
+  micro_report (m, "object_new_unref", 0, MICRO_MIN_OPS, per_op);
+
+  free (per_op);
+}
+
+static void
+micro_usage (const char *name)
+{
+  fprintf (stderr,
+	   "Usage: %s [-o FILE] [-n ROUNDS] [-seed N]\n"
+	   "\n"
+	   "Times the stacking, layout, list and object code without an X\n"
+	   "server, with %d, %d and %d clients.\n",
+	   name,
+	   micro_sizes[0], micro_sizes[1], micro_sizes[2]);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  Micro        m;
+  unsigned int seed = 1;
+  int          i;
+
+  memset (&m, 0, sizeof (m));
+  m.out          = stdout;
+  m.rounds       = 21;
+  m.first_result = True;
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (i == argc - 1)
+	micro_usage (argv[0]);
+
+      if (!strcmp (argv[i], "-o"))
+	{
+	  if (!(m.out = fopen (argv[++i], "w")))
+	    {
+	      perror (argv[i]);
+	      return 1;
+	    }
+	}
+      else if (!strcmp (argv[i], "-n"))
+	m.rounds = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-seed"))
+	seed = strtoul (argv[++i], NULL, 0);
+      else
+	micro_usage (argv[0]);
+    }
+
+  if (m.rounds < 1)
+    micro_usage (argv[0]);
+
+  srand (seed);
+
+  mb_wm_object_init ();
+
+  /*
+   * Only the stack fields of the window manager are used; it is never
+   * initialised, so there is no display behind it.
+   */
+  m.wm = mb_wm_util_malloc0 (sizeof (MBWindowManager));
+
+  fprintf (m.out, "{\n  \"suite\": \"mb-wm-microbench\",\n"
+	   "  \"rounds\": %d,\n  \"results\": [", m.rounds);
+
+  for (i = 0; i < (int) (sizeof (micro_sizes) / sizeof (int)); ++i)
+    {
+      micro_clients_new (&m, micro_sizes[i]);
+
+      micro_stack_insert_remove (&m);
+      micro_stack_move (&m);
+      micro_stack_ensure (&m);
+      micro_stack_cycle (&m);
+      micro_list (&m);
+
+      micro_clients_free (&m);
+    }
+
+  micro_layout (&m);
+  micro_object (&m);
+
+  fprintf (m.out, "\n  ]\n}\n");
+
+  if (m.out != stdout)
+    fclose (m.out);
+
+  free (m.wm);
+
+  return 0;
+}
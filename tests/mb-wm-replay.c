@@ -0,0 +1,496 @@
+/*
+ * Replays a log written with MB_WM_RECORD against an in-process window
+ * manager, for benchmarking a captured session offline.
+ *
+ * The replay acts as the clients of the recorded session: it creates a
+ * window for every client window the log refers to, gives it the property
+ * contents the window manager read back then, and turns the recorded
+ * MapRequest, ConfigureRequest, PropertyNotify, ClientMessage, DestroyNotify
+ * and synthetic (ICCCM withdraw) UnmapNotify events into the client
+ * requests that cause them.  Events the window manager caused itself are
+ * regenerated rather than replayed; input events are not replayed.  The
+ * windows the window manager adopted at startup are mapped before it is
+ * started.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mb-wm-bench-common.h"
+
+#include <unistd.h>
+
+typedef struct Replay
+{
+  MBWindowManager *wm;
+  Display         *dpy;       /* the client connection */
+  Window           root;
+  guint32          recorded_root;
+
+  GHashTable      *atoms;     /* recorded atom -> name */
+  GHashTable      *windows;   /* recorded window -> replica */
+  GHashTable      *requests;  /* cookie -> guint32[2] window, property */
+  GHashTable      *values;    /* "window:property" -> last value set */
+
+  Atom             net_wm_state;
+} Replay;
+
+static const MBWMRecord *
+replay_next (const char *data, gsize size, gsize *offset)
+{
+  const MBWMRecord *rec;
+
+  if (*offset + sizeof (MBWMRecord) > size)
+    return NULL;
+
+  rec = (const MBWMRecord *) (data + *offset);
+
+  if (*offset + sizeof (MBWMRecord) + rec->len > size)
+    return NULL;
+
+  *offset += sizeof (MBWMRecord) + rec->len;
+
+  return rec;
+}
+
+static Atom
+replay_atom (Replay *r, guint32 atom)
+{
+  const char *name;
+
+  if (atom <= XA_LAST_PREDEFINED)
+    return atom;
+
+  name = g_hash_table_lookup (r->atoms, GUINT_TO_POINTER (atom));
+
+  return name ? XInternAtom (r->dpy, name, False) : None;
+}
+
+/* The replica of a recorded window, created on first use if @create */
+static Window
+replay_window (Replay *r, guint32 xwin, Bool create)
+{
+  Window win;
+
+  if (xwin == None)
+    return None;
+
+  if (xwin == r->recorded_root)
+    return r->root;
+
+  win = GPOINTER_TO_UINT (g_hash_table_lookup (r->windows,
+					       GUINT_TO_POINTER (xwin)));
+  if (win || !create)
+    return win;
+
+  win = XCreateSimpleWindow (r->dpy, r->root, 0, 0, 100, 100, 0, 0, 0);
+  g_hash_table_insert (r->windows, GUINT_TO_POINTER (xwin),
+		       GUINT_TO_POINTER (win));
+
+  return win;
+}
+
+static void
+replay_value_free (gpointer value)
+{
+  g_string_free (value, TRUE);
+}
+
+/* Gives a replica the property contents the window manager read back */
+static void
+replay_property (Replay *r, const guint32 *reply, const guchar *data,
+		 gsize len)
+{
+  guint32 *req;
+  Window   win;
+  Atom     prop, type;
+  guint32  format = reply[2], nitems = reply[3];
+  char    *key;
+  GString *value;
+
+  req = g_hash_table_lookup (r->requests, GUINT_TO_POINTER (reply[0]));
+  if (!req)
+    return;
+
+  win  = replay_window (r, req[0], True);
+  prop = replay_atom (r, req[1]);
+  type = replay_atom (r, reply[1]);
+
+  if (!win || !prop)
+    return;
+
+  /* Only touch the property when it changes, like a real client */
+  key   = g_strdup_printf ("%lx:%lx", win, prop);
+  value = g_string_new_len ((const char *) reply + 4, 12);
+  g_string_append_len (value, (const char *) data, len);
+
+  if (g_hash_table_lookup (r->values, key))
+    {
+      GString *old = g_hash_table_lookup (r->values, key);
+
+      if (old->len == value->len && !memcmp (old->str, value->str, old->len))
+	{
+	  g_string_free (value, TRUE);
+	  g_free (key);
+	  return;
+	}
+    }
+
+  g_hash_table_replace (r->values, key, value);
+
+  if (reply[1] == None)
+    {
+      XDeleteProperty (r->dpy, win, prop);
+      return;
+    }
+
+  if (format == 32)
+    {
+      long    *items = g_new (long, nitems);
+      guint32 *in = (guint32 *) data;
+      guint32  i;
+
+      for (i = 0; i < nitems; i++)
+	{
+	  if (type == XA_ATOM)
+	    items[i] = replay_atom (r, in[i]);
+	  else if (type == XA_WINDOW)
+	    items[i] = replay_window (r, in[i], True);
+	  else
+	    items[i] = in[i];
+	}
+
+      XChangeProperty (r->dpy, win, prop, type, 32, PropModeReplace,
+		       (guchar *) items, nitems);
+      g_free (items);
+    }
+  else
+    XChangeProperty (r->dpy, win, prop, type, format, PropModeReplace,
+		     data, nitems);
+}
+
+/* Handles everything but events */
+static void
+replay_record (Replay *r, const MBWMRecord *rec)
+{
+  const guint32 *words = (const guint32 *) (rec + 1);
+
+  switch (rec->kind)
+    {
+    case MBWMRecordAtom:
+      g_hash_table_replace (r->atoms, GUINT_TO_POINTER (words[0]),
+			    g_strndup ((const char *) (words + 1),
+				       rec->len - 4));
+      break;
+    case MBWMRecordPropertyRequest:
+      g_hash_table_replace (r->requests, GUINT_TO_POINTER (words[0]),
+			    g_memdup (words + 1, 8));
+      break;
+    case MBWMRecordPropertyReply:
+      replay_property (r, words, (const guchar *) (words + 4), rec->len - 16);
+      break;
+    case MBWMRecordAdopt:
+      {
+	Window win = replay_window (r, words[0], True);
+
+	XMoveResizeWindow (r->dpy, win, (gint32) words[1], (gint32) words[2],
+			   MAX (words[3], 1), MAX (words[4], 1));
+	XMapWindow (r->dpy, win);
+      }
+      break;
+    }
+}
+
+/* Issues the client request behind a recorded event; False if there is none */
+static Bool
+replay_event (Replay *r, XEvent *xev)
+{
+  Window win;
+
+  switch (xev->type)
+    {
+    case MapRequest:
+      win = replay_window (r, xev->xmaprequest.window, True);
+      XMapWindow (r->dpy, win);
+      return True;
+
+    case ConfigureRequest:
+      {
+	XConfigureRequestEvent *e = &xev->xconfigurerequest;
+	XWindowChanges          changes;
+	unsigned int            mask = e->value_mask;
+
+	win = replay_window (r, e->window, True);
+
+	changes.x            = e->x;
+	changes.y            = e->y;
+	changes.width        = e->width;
+	changes.height       = e->height;
+	changes.border_width = e->border_width;
+	changes.stack_mode   = e->detail;
+	changes.sibling      = replay_window (r, e->above, False);
+
+	if (!changes.sibling)
+	  mask &= ~CWSibling;
+
+	XConfigureWindow (r->dpy, win, mask, &changes);
+      }
+      return True;
+
+    case PropertyNotify:
+      {
+	Atom prop = replay_atom (r, xev->xproperty.atom);
+
+	/* New values were set from the property replies already */
+	if (xev->xproperty.state != PropertyDelete || !prop ||
+	    !(win = replay_window (r, xev->xproperty.window, False)))
+	  return False;
+
+	XDeleteProperty (r->dpy, win, prop);
+      }
+      return True;
+
+    case ClientMessage:
+      {
+	XClientMessageEvent e = xev->xclient;
+
+	e.display      = r->dpy;
+	e.window       = replay_window (r, e.window, True);
+	e.message_type = replay_atom (r, e.message_type);
+
+	if (e.message_type == r->net_wm_state)
+	  {
+	    e.data.l[1] = replay_atom (r, e.data.l[1]);
+	    e.data.l[2] = replay_atom (r, e.data.l[2]);
+	  }
+
+	XSendEvent (r->dpy, r->root, False,
+		    SubstructureRedirectMask | SubstructureNotifyMask,
+		    (XEvent *) &e);
+      }
+      return True;
+
+    case UnmapNotify:
+      if (!xev->xunmap.send_event ||
+	  !(win = replay_window (r, xev->xunmap.window, False)))
+	return False;
+
+      XWithdrawWindow (r->dpy, win, DefaultScreen (r->dpy));
+      return True;
+
+    case DestroyNotify:
+      if (!(win = replay_window (r, xev->xdestroywindow.window, False)))
+	return False;
+
+      XDestroyWindow (r->dpy, win);
+      g_hash_table_remove (r->windows,
+			   GUINT_TO_POINTER (xev->xdestroywindow.window));
+      return True;
+    }
+
+  return False;
+}
+
+static void
+replay_usage (const char *name)
+{
+  fprintf (stderr,
+	   "Usage: %s [-compressed] [-theme DIR] [-o FILE] LOG\n"
+	   "\n"
+	   "Replays LOG, written with MB_WM_RECORD, with the original timing\n"
+	   "or, with -compressed, as fast as the window manager keeps up.\n"
+	   "Must be run on an otherwise unmanaged display, e.g. Xvfb.\n",
+	   name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  Replay                  r;
+  const MBWMRecordHeader *header;
+  const MBWMRecord       *rec;
+  const char             *theme = NULL, *log = NULL;
+  FILE                   *out = stdout;
+  Bool                    compressed = False;
+  GError                 *error = NULL;
+  GArray                 *samples;
+  char                   *data;
+  gsize                   size, offset, applied = 0;
+  double                  start, total = 0.0;
+  int                     skipped = 0;
+  guint                   i;
+
+  for (i = 1; i < (guint) argc; ++i)
+    {
+      if (!strcmp (argv[i], "-compressed"))
+	compressed = True;
+      else if (!strcmp (argv[i], "-theme") && i + 1 < (guint) argc)
+	theme = argv[++i];
+      else if (!strcmp (argv[i], "-o") && i + 1 < (guint) argc)
+	{
+	  if (!(out = fopen (argv[++i], "w")))
+	    {
+	      perror (argv[i]);
+	      return 1;
+	    }
+	}
+      else if (!log && argv[i][0] != '-')
+	log = argv[i];
+      else
+	replay_usage (argv[0]);
+    }
+
+  if (!log)
+    replay_usage (argv[0]);
+
+  if (!g_file_get_contents (log, &data, &size, &error))
+    {
+      fprintf (stderr, "%s: %s\n", argv[0], error->message);
+      return 1;
+    }
+
+  header = (const MBWMRecordHeader *) data;
+  if (size < sizeof (*header) ||
+      memcmp (header->magic, MBWM_RECORD_MAGIC, sizeof (header->magic)))
+    {
+      fprintf (stderr, "%s: %s is not an event log\n", argv[0], log);
+      return 1;
+    }
+
+  memset (&r, 0, sizeof (r));
+  r.recorded_root = header->root;
+  r.atoms    = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  r.windows  = g_hash_table_new (NULL, NULL);
+  r.requests = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  r.values   = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+				      replay_value_free);
+
+  if (!(r.dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "%s: cannot open display\n", argv[0]);
+      return 1;
+    }
+
+  r.root         = DefaultRootWindow (r.dpy);
+  r.net_wm_state = XInternAtom (r.dpy, "_NET_WM_STATE", False);
+
+  if (header->width != (guint32) DisplayWidth (r.dpy, DefaultScreen (r.dpy)) ||
+      header->height != (guint32) DisplayHeight (r.dpy, DefaultScreen (r.dpy)))
+    fprintf (stderr, "%s: warning: recorded on a %ux%u screen\n",
+	     argv[0], header->width, header->height);
+
+  /*
+   * Everything up to the first event was read at startup: the windows
+   * that were there already, with their properties.
+   */
+  offset = sizeof (*header);
+
+  while ((rec = replay_next (data, size, &offset)) &&
+	 rec->kind != MBWMRecordEvent)
+    {
+      replay_record (&r, rec);
+      applied = offset;
+    }
+
+  XSync (r.dpy, False);
+
+  if (!(r.wm = bench_wm_new (argv[0], theme)))
+    {
+      fprintf (stderr, "%s: failed to create window manager\n", argv[0]);
+      return 1;
+    }
+
+  samples = g_array_new (FALSE, FALSE, sizeof (double));
+  offset  = sizeof (*header);
+  start   = bench_now_us ();
+
+  while ((rec = replay_next (data, size, &offset)))
+    {
+      const MBWMRecord *next;
+      gsize             ahead = offset;
+      XEvent            xev;
+      double            t;
+
+      if (rec->kind != MBWMRecordEvent)
+	{
+	  if (offset > applied)
+	    replay_record (&r, rec);
+	  continue;
+	}
+
+      /*
+       * Whatever the window manager read while handling this event is how
+       * the clients had left things before it; set that up first.
+       */
+      while ((next = replay_next (data, size, &ahead)) &&
+	     next->kind != MBWMRecordEvent)
+	{
+	  replay_record (&r, next);
+	  applied = ahead;
+	}
+
+      memset (&xev, 0, sizeof (xev));
+      memcpy (&xev, rec + 1, MIN (rec->len, sizeof (xev)));
+
+      if (!compressed)
+	{
+	  double due = start + rec->usec;
+
+	  t = bench_now_us ();
+	  if (due > t)
+	    usleep (due - t);
+	}
+
+      t = bench_now_us ();
+
+      if (!replay_event (&r, &xev))
+	skipped++;
+
+      XSync (r.dpy, False);
+      bench_pump (r.wm);
+
+      t = bench_now_us () - t;
+      g_array_append_val (samples, t);
+      total += t;
+    }
+
+  if (samples->len)
+    {
+      double *s = (double *) samples->data;
+      guint   n = samples->len;
+
+      qsort (s, n, sizeof (double), bench_compare_double);
+
+      fprintf (out, "{\n  \"suite\": \"mb-wm-replay\",\n"
+	       "  \"log\": \"%s\",\n  \"timing\": \"%s\",\n"
+	       "  \"events\": %u,\n  \"replayed\": %u,\n"
+	       "  \"elapsed_us\": %.1f,\n"
+	       "  \"wm_us\": { \"total\": %.1f, \"median\": %.1f, "
+	       "\"p95\": %.1f, \"max\": %.1f }\n}\n",
+	       log, compressed ? "compressed" : "original",
+	       n, n - skipped, bench_now_us () - start,
+	       total, s[n / 2], s[(n * 95) / 100], s[n - 1]);
+    }
+
+  if (out != stdout)
+    fclose (out);
+
+  g_array_free (samples, TRUE);
+  g_free (data);
+  XCloseDisplay (r.dpy);
+
+  return 0;
+}
@@ -0,0 +1,765 @@
+/*
+ * Client storm generator for libmatchbox2 based window managers.
+ *
+ * Creates and destroys windows of the chosen types at a fixed rate against
+ * the window manager already running on $DISPLAY, while spamming it with
+ * title, user time and geometry changes.  Uses nothing but Xlib, so it can
+ * be pointed at any build of the window manager.
+ *
+ * The map latency of a window is the time from its XMapWindow() to when
+ * both it and the frame it was reparented into, if any, are mapped.
+ * Results are written as JSON, in the same shape as mb-wm-bench's.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+/* Frame maps seen before we know which client they belong to */
+#define STORM_ROOT_MAPS 64
+
+typedef enum StormType
+{
+  StormTypeApp = 0,
+  StormTypeDialog,
+  StormTypeMenu,
+  StormTypeNotification,
+  StormTypeInput,
+  StormTypePanel,
+  StormTypeHomeApplet,
+  StormTypeLegacyMenu,
+
+  StormTypeCount
+} StormType;
+
+static const struct
+{
+  const char *name;
+  const char *atom;
+} storm_types[StormTypeCount] = {
+  { "app",          "_NET_WM_WINDOW_TYPE_NORMAL" },
+  { "dialog",       "_NET_WM_WINDOW_TYPE_DIALOG" },
+  { "menu",         "_NET_WM_WINDOW_TYPE_MENU" },
+  { "notification", "_NET_WM_WINDOW_TYPE_NOTIFICATION" },
+  { "input",        "_NET_WM_WINDOW_TYPE_INPUT" },
+  { "panel",        "_NET_WM_WINDOW_TYPE_DOCK" },
+  { "home-applet",  "_HILDON_WM_WINDOW_TYPE_HOME_APPLET" },
+  { "legacy-menu",  "_HILDON_WM_WINDOW_TYPE_LEGACY_MENU" },
+};
+
+typedef struct StormWindow
+{
+  Window     xwin;
+  Window     frame;         /* None until reparented */
+  StormType  type;
+  int        depth;         /* number of transient parents */
+  double     map_sent;
+  double     client_mapped; /* 0 until seen */
+  double     frame_mapped;
+  double     destroy_at;
+  Bool       reported;
+} StormWindow;
+
+typedef struct StormSamples
+{
+  double *samples;
+  int     n;
+  int     size;
+} StormSamples;
+
+typedef struct Storm
+{
+  Display      *dpy;
+  Window        root;
+  FILE         *out;
+
+  double        rate;           /* windows per second */
+  double        duration;       /* seconds */
+  double        lifetime;       /* microseconds */
+  double        prop_rate;      /* title/user time changes per second */
+  double        configure_rate; /* ConfigureRequests per second */
+  int           chain;          /* longest transient chain */
+  Bool          use_type[StormTypeCount];
+  StormType     types[StormTypeCount];
+  int           n_types;
+
+  Atom          type_atoms[StormTypeCount];
+  Atom          net_wm_window_type;
+  Atom          net_wm_user_time;
+  Atom          net_wm_name;
+  Atom          net_supporting_wm_check;
+  Atom          utf8_string;
+
+  StormWindow  *wins;
+  int           n_wins;
+  int           size_wins;
+
+  struct
+  {
+    Window xwin;
+    double when;
+  }             root_maps[STORM_ROOT_MAPS];
+  int           next_root_map;
+
+  StormSamples  latency[StormTypeCount];
+  StormSamples  all;
+
+  unsigned long created;
+  unsigned long unmanaged;
+  unsigned long prop_changes;
+  unsigned long configures;
+  unsigned long user_time;
+  Bool          first_result;
+} Storm;
+
+static unsigned long storm_x_errors = 0;
+
+static double
+storm_now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+storm_compare_double (const void *a, const void *b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return (da > db) - (da < db);
+}
+
+/* Windows get destroyed under our feet all the time; just count it */
+static int
+storm_error_handler (Display *dpy, XErrorEvent *error)
+{
+  storm_x_errors++;
+
+  return 0;
+}
+
+static void
+storm_samples_add (StormSamples *s, double value)
+{
+  if (s->n == s->size)
+    {
+      s->size    = s->size ? s->size * 2 : 256;
+      s->samples = realloc (s->samples, s->size * sizeof (double));
+    }
+
+  s->samples[s->n++] = value;
+}
+
+static void
+storm_report_latency (Storm *s, const char *type, StormSamples *l)
+{
+  double sum = 0.0;
+  int    i, n = l->n;
+
+  if (!n)
+    return;
+
+  qsort (l->samples, n, sizeof (double), storm_compare_double);
+
+  for (i = 0; i < n; ++i)
+    sum += l->samples[i];
+
+  fprintf (s->out, "%s\n    { \"name\": \"storm_map_latency\", "
+	   "\"type\": \"%s\", \"unit\": \"us\", \"samples\": %d, "
+	   "\"min\": %.1f, \"median\": %.1f, \"p95\": %.1f, \"max\": %.1f, "
+	   "\"mean\": %.1f }",
+	   s->first_result ? "" : ",", type, n, l->samples[0],
+	   l->samples[n / 2], l->samples[(n * 95) / 100], l->samples[n - 1],
+	   sum / n);
+
+  s->first_result = False;
+}
+
+static void
+storm_report_rate (Storm *s, const char *name, const char *unit,
+		   unsigned long events, double elapsed)
+{
+  fprintf (s->out, "%s\n    { \"name\": \"%s\", \"unit\": \"%s\", "
+	   "\"events\": %lu, \"elapsed_us\": %.1f, \"rate\": %.1f }",
+	   s->first_result ? "" : ",", name, unit, events, elapsed,
+	   events / (elapsed / 1e6));
+
+  s->first_result = False;
+}
+
+static StormWindow *
+storm_find (Storm *s, Window xwin)
+{
+  int i;
+
+  for (i = 0; i < s->n_wins; ++i)
+    if (s->wins[i].xwin == xwin)
+      return &s->wins[i];
+
+  return NULL;
+}
+
+static StormWindow *
+storm_find_frame (Storm *s, Window frame)
+{
+  int i;
+
+  for (i = 0; i < s->n_wins; ++i)
+    if (s->wins[i].frame == frame)
+      return &s->wins[i];
+
+  return NULL;
+}
+
+/* Records the latency once the window and its frame are both up */
+static void
+storm_check_mapped (Storm *s, StormWindow *w)
+{
+  double done;
+
+  if (w->reported || !w->client_mapped)
+    return;
+
+  if (w->frame != None && !w->frame_mapped)
+    return;
+
+  done = w->client_mapped;
+  if (w->frame != None && w->frame_mapped > done)
+    done = w->frame_mapped;
+
+  storm_samples_add (&s->latency[w->type], done - w->map_sent);
+  storm_samples_add (&s->all, done - w->map_sent);
+  w->reported = True;
+}
+
+/*
+ * A live window a new one of the given type can be transient for, or
+ * NULL if it should not be transient.
+ */
+static StormWindow *
+storm_pick_parent (Storm *s, StormType type)
+{
+  int i;
+
+  if (type != StormTypeDialog && type != StormTypeMenu)
+    return NULL;
+
+  for (i = s->n_wins - 1; i >= 0; --i)
+    {
+      StormWindow *w = &s->wins[i];
+
+      if (w->type == StormTypeApp)
+	return w;
+
+      if (type == StormTypeDialog && w->type == StormTypeDialog &&
+	  w->depth < s->chain)
+	return w;
+    }
+
+  return NULL;
+}
+
+static void
+storm_create_window (Storm *s, double now)
+{
+  StormType    type = s->types[rand () % s->n_types];
+  StormWindow *parent = storm_pick_parent (s, type);
+  Window       parent_xwin = parent ? parent->xwin : None;
+  int          depth = parent ? parent->depth + 1 : 0;
+  StormWindow *w;
+  char         name[64];
+
+  /* parent is gone after this */
+  if (s->n_wins == s->size_wins)
+    {
+      s->size_wins = s->size_wins ? s->size_wins * 2 : 64;
+      s->wins      = realloc (s->wins, s->size_wins * sizeof (StormWindow));
+    }
+
+  w = &s->wins[s->n_wins];
+  memset (w, 0, sizeof (*w));
+
+  w->type       = type;
+  w->depth      = depth;
+  w->xwin       = XCreateSimpleWindow (s->dpy, s->root,
+				       rand () % 200, rand () % 200,
+				       100 + rand () % 300, 50 + rand () % 200,
+				       0, 0, 0);
+  w->destroy_at = now + s->lifetime;
+
+  XSelectInput (s->dpy, w->xwin, StructureNotifyMask);
+
+  snprintf (name, sizeof (name), "mb-wm-storm %s %lu",
+	    storm_types[type].name, s->created);
+  XStoreName (s->dpy, w->xwin, name);
+
+  XChangeProperty (s->dpy, w->xwin, s->net_wm_window_type, XA_ATOM, 32,
+		   PropModeReplace, (unsigned char *) &s->type_atoms[type], 1);
+
+  if (parent_xwin != None)
+    XSetTransientForHint (s->dpy, w->xwin, parent_xwin);
+
+  XFlush (s->dpy);
+
+  w->map_sent = storm_now_us ();
+  XMapWindow (s->dpy, w->xwin);
+  XFlush (s->dpy);
+
+  s->n_wins++;
+  s->created++;
+}
+
+static void
+storm_destroy_window (Storm *s, int i)
+{
+  if (!s->wins[i].reported)
+    s->unmanaged++;
+
+  XDestroyWindow (s->dpy, s->wins[i].xwin);
+
+  s->wins[i] = s->wins[--s->n_wins];
+}
+
+static void
+storm_change_properties (Storm *s)
+{
+  StormWindow *w;
+  char         name[64];
+  long         user_time;
+
+  if (!s->n_wins)
+    return;
+
+  w = &s->wins[rand () % s->n_wins];
+
+  snprintf (name, sizeof (name), "mb-wm-storm %lu", s->prop_changes);
+  XStoreName (s->dpy, w->xwin, name);
+  XChangeProperty (s->dpy, w->xwin, s->net_wm_name, s->utf8_string, 8,
+		   PropModeReplace, (unsigned char *) name, strlen (name));
+
+  user_time = ++s->user_time;
+  XChangeProperty (s->dpy, w->xwin, s->net_wm_user_time, XA_CARDINAL, 32,
+		   PropModeReplace, (unsigned char *) &user_time, 1);
+
+  s->prop_changes += 3;
+}
+
+static void
+storm_configure (Storm *s)
+{
+  StormWindow *w;
+
+  if (!s->n_wins)
+    return;
+
+  w = &s->wins[rand () % s->n_wins];
+
+  XMoveResizeWindow (s->dpy, w->xwin, rand () % 200, rand () % 200,
+		     100 + rand () % 300, 50 + rand () % 200);
+  s->configures++;
+}
+
+static void
+storm_handle_event (Storm *s, XEvent *xev, double now)
+{
+  StormWindow *w;
+  int          i;
+
+  switch (xev->type)
+    {
+    case MapNotify:
+      if (xev->xmap.event == s->root)
+	{
+	  /* A top level was mapped, maybe the frame of one of ours */
+	  if ((w = storm_find_frame (s, xev->xmap.window)))
+	    {
+	      w->frame_mapped = now;
+	      storm_check_mapped (s, w);
+	    }
+	  else
+	    {
+	      i = s->next_root_map++ % STORM_ROOT_MAPS;
+	      s->root_maps[i].xwin = xev->xmap.window;
+	      s->root_maps[i].when = now;
+	    }
+	}
+      else if ((w = storm_find (s, xev->xmap.window)))
+	{
+	  w->client_mapped = now;
+	  storm_check_mapped (s, w);
+	}
+      break;
+
+    case ReparentNotify:
+      if (xev->xreparent.event != xev->xreparent.window ||
+	  !(w = storm_find (s, xev->xreparent.window)))
+	break;
+
+      w->frame        = xev->xreparent.parent == s->root
+			? None : xev->xreparent.parent;
+      w->frame_mapped = 0;
+
+      for (i = 0; w->frame != None && i < STORM_ROOT_MAPS; ++i)
+	if (s->root_maps[i].xwin == w->frame)
+	  w->frame_mapped = s->root_maps[i].when;
+
+      storm_check_mapped (s, w);
+      break;
+
+    case UnmapNotify:
+      if (xev->xunmap.event == s->root &&
+	  (w = storm_find_frame (s, xev->xunmap.window)))
+	w->frame_mapped = 0;
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+storm_pump (Storm *s)
+{
+  XEvent xev;
+
+  while (XPending (s->dpy))
+    {
+      XNextEvent (s->dpy, &xev);
+      storm_handle_event (s, &xev, storm_now_us ());
+    }
+}
+
+/* Waits for events until the deadline, at most */
+static void
+storm_wait (Storm *s, double deadline)
+{
+  struct timeval tv;
+  fd_set         fds;
+  double         usec;
+  int            fd = ConnectionNumber (s->dpy);
+
+  XFlush (s->dpy);
+  storm_pump (s);
+
+  usec = deadline - storm_now_us ();
+  if (usec <= 0)
+    return;
+
+  tv.tv_sec  = (long) (usec / 1e6);
+  tv.tv_usec = (long) usec % 1000000;
+
+  FD_ZERO (&fds);
+  FD_SET (fd, &fds);
+
+  if (select (fd + 1, &fds, NULL, NULL, &tv) > 0)
+    storm_pump (s);
+}
+
+static Bool
+storm_wm_running (Storm *s)
+{
+  Atom           type;
+  int            format;
+  unsigned long  n, left;
+  unsigned char *data = NULL;
+  Bool           ret;
+
+  if (XGetWindowProperty (s->dpy, s->root, s->net_supporting_wm_check,
+			  0, 1, False, XA_WINDOW, &type, &format, &n, &left,
+			  &data) != Success)
+    return False;
+
+  ret = type == XA_WINDOW && n == 1;
+
+  if (data)
+    XFree (data);
+
+  return ret;
+}
+
+static double
+storm_next (double from, double rate)
+{
+  return rate > 0 ? from + 1e6 / rate : 1e300;
+}
+
+static void
+storm_run (Storm *s)
+{
+  double start = storm_now_us ();
+  double end = start + s->duration * 1e6;
+  double next_create = start;
+  double next_prop = start;
+  double next_configure = start;
+  double elapsed;
+  int    i;
+
+  for (;;)
+    {
+      double now = storm_now_us ();
+      double deadline = now + 10000;
+
+      if (now >= end && !s->n_wins)
+	break;
+
+      for (i = s->n_wins - 1; i >= 0; --i)
+	if (s->wins[i].destroy_at <= now)
+	  storm_destroy_window (s, i);
+
+      if (now < end)
+	{
+	  while (next_create <= now)
+	    {
+	      storm_create_window (s, now);
+	      next_create = storm_next (next_create, s->rate);
+	    }
+
+	  while (next_prop <= now)
+	    {
+	      storm_change_properties (s);
+	      next_prop = storm_next (next_prop, s->prop_rate);
+	    }
+
+	  while (next_configure <= now)
+	    {
+	      storm_configure (s);
+	      next_configure = storm_next (next_configure, s->configure_rate);
+	    }
+
+	  if (next_create < deadline)
+	    deadline = next_create;
+	  if (next_prop < deadline)
+	    deadline = next_prop;
+	  if (next_configure < deadline)
+	    deadline = next_configure;
+	}
+
+      for (i = 0; i < s->n_wins; ++i)
+	if (s->wins[i].destroy_at < deadline)
+	  deadline = s->wins[i].destroy_at;
+
+      storm_wait (s, deadline);
+    }
+
+  XSync (s->dpy, False);
+  storm_pump (s);
+
+  elapsed = storm_now_us () - start;
+
+  for (i = 0; i < StormTypeCount; ++i)
+    storm_report_latency (s, storm_types[i].name, &s->latency[i]);
+
+  storm_report_latency (s, "all", &s->all);
+
+  storm_report_rate (s, "storm_windows_created", "windows/s",
+		     s->created, elapsed);
+  storm_report_rate (s, "storm_windows_mapped", "windows/s",
+		     (unsigned long) s->all.n, elapsed);
+  storm_report_rate (s, "storm_property_changes", "events/s",
+		     s->prop_changes, elapsed);
+  storm_report_rate (s, "storm_configure_requests", "events/s",
+		     s->configures, elapsed);
+}
+
+static Bool
+storm_parse_types (Storm *s, const char *list)
+{
+  char *copy = strdup (list);
+  char *name;
+  int   i;
+
+  memset (s->use_type, 0, sizeof (s->use_type));
+
+  for (name = strtok (copy, ","); name; name = strtok (NULL, ","))
+    {
+      for (i = 0; i < StormTypeCount; ++i)
+	if (!strcmp (name, storm_types[i].name))
+	  break;
+
+      if (i == StormTypeCount)
+	{
+	  fprintf (stderr, "Unknown window type '%s'\n", name);
+	  free (copy);
+	  return False;
+	}
+
+      s->use_type[i] = True;
+    }
+
+  free (copy);
+  return True;
+}
+
+static void
+storm_usage (const char *name)
+{
+  int i;
+
+  fprintf (stderr,
+	   "Usage: %s [-o FILE] [-rate WINDOWS/S] [-duration S]\n"
+	   "          [-lifetime MS] [-props CHANGES/S] [-configures REQUESTS/S]\n"
+	   "          [-chain DEPTH] [-types TYPE,...] [-seed N] [-wait S]\n"
+	   "\n"
+	   "Types:",
+	   name);
+
+  for (i = 0; i < StormTypeCount; ++i)
+    fprintf (stderr, " %s", storm_types[i].name);
+
+  fprintf (stderr, "\n\nA window manager must be running on the display.\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  Storm   s;
+  double  wait = 5.0;
+  double  lifetime_ms = 1000.0;
+  double  give_up;
+  int     i;
+
+  memset (&s, 0, sizeof (s));
+  s.out            = stdout;
+  s.rate           = 20.0;
+  s.duration       = 10.0;
+  s.prop_rate      = 100.0;
+  s.configure_rate = 50.0;
+  s.chain          = 3;
+  s.first_result   = True;
+
+  for (i = 0; i < StormTypeCount; ++i)
+    s.use_type[i] = True;
+
+  srand (1);
+
+  for (i = 1; i < argc; ++i)
+    {
+      if (i == argc - 1)
+	storm_usage (argv[0]);
+
+      if (!strcmp (argv[i], "-o"))
+	{
+	  if (!(s.out = fopen (argv[++i], "w")))
+	    {
+	      perror (argv[i]);
+	      return 1;
+	    }
+	}
+      else if (!strcmp (argv[i], "-rate"))
+	s.rate = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-duration"))
+	s.duration = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-lifetime"))
+	lifetime_ms = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-props"))
+	s.prop_rate = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-configures"))
+	s.configure_rate = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-chain"))
+	s.chain = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-types"))
+	{
+	  if (!storm_parse_types (&s, argv[++i]))
+	    storm_usage (argv[0]);
+	}
+      else if (!strcmp (argv[i], "-seed"))
+	srand (atoi (argv[++i]));
+      else if (!strcmp (argv[i], "-wait"))
+	wait = atof (argv[++i]);
+      else
+	storm_usage (argv[0]);
+    }
+
+  for (i = 0; i < StormTypeCount; ++i)
+    if (s.use_type[i])
+      s.types[s.n_types++] = i;
+
+  if (s.rate <= 0 || s.duration <= 0 || lifetime_ms <= 0 || !s.n_types)
+    storm_usage (argv[0]);
+
+  s.lifetime = lifetime_ms * 1000.0;
+
+  if (!(s.dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "%s: cannot open display\n", argv[0]);
+      return 1;
+    }
+
+  XSetErrorHandler (storm_error_handler);
+
+  s.root = DefaultRootWindow (s.dpy);
+
+  for (i = 0; i < StormTypeCount; ++i)
+    s.type_atoms[i] = XInternAtom (s.dpy, storm_types[i].atom, False);
+
+  s.net_wm_window_type = XInternAtom (s.dpy, "_NET_WM_WINDOW_TYPE", False);
+  s.net_wm_user_time   = XInternAtom (s.dpy, "_NET_WM_USER_TIME", False);
+  s.net_wm_name        = XInternAtom (s.dpy, "_NET_WM_NAME", False);
+  s.utf8_string        = XInternAtom (s.dpy, "UTF8_STRING", False);
+  s.net_supporting_wm_check =
+    XInternAtom (s.dpy, "_NET_SUPPORTING_WM_CHECK", False);
+
+  /* The window manager may still be starting up */
+  give_up = storm_now_us () + wait * 1e6;
+  while (!storm_wm_running (&s))
+    {
+      if (storm_now_us () > give_up)
+	{
+	  fprintf (stderr, "%s: no window manager running\n", argv[0]);
+	  return 1;
+	}
+
+      usleep (100000);
+    }
+
+  XSelectInput (s.dpy, s.root, SubstructureNotifyMask);
+
+  fprintf (s.out, "{\n  \"suite\": \"mb-wm-storm\",\n"
+	   "  \"rate\": %.1f,\n  \"duration_s\": %.1f,\n"
+	   "  \"lifetime_ms\": %.1f,\n  \"types\": \"",
+	   s.rate, s.duration, lifetime_ms);
+
+  for (i = 0; i < s.n_types; ++i)
+    fprintf (s.out, "%s%s", i ? "," : "", storm_types[s.types[i]].name);
+
+  fprintf (s.out, "\",\n  \"results\": [");
+
+  storm_run (&s);
+
+  fprintf (s.out, "\n  ],\n  \"unmanaged\": %lu,\n  \"x_errors\": %lu\n}\n",
+	   s.unmanaged, storm_x_errors);
+
+  if (s.out != stdout)
+    fclose (s.out);
+
+  XCloseDisplay (s.dpy);
+
+  return 0;
+}
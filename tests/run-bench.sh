@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Runs mb-wm-bench on a private Xvfb server.
+#
+# usage: run-bench.sh BENCH THEMEDIR [OUTPUT [STORM STORM_OUTPUT]]
+#
+# THEMEDIR is the directory holding the Default and PngSample themes, the
+# benchmark switches between the two.  Results go to OUTPUT, or stdout.
+#
+# If STORM is given, mb-wm-storm is then run against BENCH -serve, with
+# $MB_STORM_ARGS, and its results go to STORM_OUTPUT.
+
+bench=$1
+themes=$2
+output=${3:--}
+storm=$4
+storm_output=${5:--}
+
+if [ -z "$bench" ] || [ -z "$themes" ]; then
+  echo "usage: $0 BENCH THEMEDIR [OUTPUT [STORM STORM_OUTPUT]]" >&2
+  exit 1
+fi
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+  echo "$0: Xvfb not found" >&2
+  exit 1
+fi
+
+# Pick the first display number without a lock file.
+num=${MB_BENCH_DISPLAY:-90}
+while [ -e /tmp/.X$num-lock ]; do
+  num=$((num + 1))
+done
+
+Xvfb :$num -screen 0 ${MB_BENCH_SCREEN:-800x480x24} -nolisten tcp \
+  >/dev/null 2>&1 &
+xvfb=$!
+wm=
+trap 'kill $wm $xvfb 2>/dev/null' EXIT INT TERM
+
+# Wait for the server to come up.
+tries=50
+while [ ! -e /tmp/.X11-unix/X$num ] && [ $tries -gt 0 ]; do
+  sleep 0.1
+  tries=$((tries - 1))
+done
+
+set -- -theme "$themes/Default" -alt-theme "$themes/PngSample"
+if [ -n "$MB_BENCH_ITERATIONS" ]; then
+  set -- "$@" -n "$MB_BENCH_ITERATIONS"
+fi
+if [ "$output" != "-" ]; then
+  set -- "$@" -o "$output"
+fi
+
+DISPLAY=:$num "$bench" "$@" || exit 1
+
+if [ -n "$storm" ]; then
+  DISPLAY=:$num "$bench" -serve -theme "$themes/Default" &
+  wm=$!
+
+  set -- -wait 10
+  if [ "$storm_output" != "-" ]; then
+    set -- "$@" -o "$storm_output"
+  fi
+
+  # MB_STORM_ARGS is split on purpose
+  DISPLAY=:$num "$storm" "$@" $MB_STORM_ARGS
+fi